@@ -0,0 +1,320 @@
+// Benchmarks of the scheduler hot paths, written as JSON so results can be compared across commits
+#define SCHEDULING_NO_MAIN
+#include "Scheduling_System.cpp"
+
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Every allocation in the process is counted, so each case can report allocations per operation.
+// All the replaceable forms are defined, aligned and nothrow ones included, so none slips past the count
+// and every block goes back to the allocator it came from.
+static atomic<uint64_t> allocationCount{ 0 };
+
+// Each replacement below frees what the matching one allocated, but once GCC inlines a delete it only
+// sees free() given a pointer from operator new, and warns
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    if (void* block = malloc(size ? size : 1)) return block;
+    throw bad_alloc();
+}
+
+void* operator new(size_t size, align_val_t alignment) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+#ifdef _WIN32
+    if (void* block = _aligned_malloc(size ? size : 1, static_cast<size_t>(alignment))) return block;
+#else
+    void* block;
+    if (posix_memalign(&block, max(static_cast<size_t>(alignment), sizeof(void*)), size ? size : 1) == 0) return block;
+#endif
+    throw bad_alloc();
+}
+
+void freeAligned(void* block) {
+#ifdef _WIN32
+    _aligned_free(block);
+#else
+    free(block);
+#endif
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new[](size_t size, align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    try {
+        return operator new(size);
+    }
+    catch (const bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+    return operator new(size, nothrow);
+}
+
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+    try {
+        return operator new(size, alignment);
+    }
+    catch (const bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+    return operator new(size, alignment, nothrow);
+}
+
+void operator delete(void* block) noexcept {
+    free(block);
+}
+
+void operator delete[](void* block) noexcept {
+    free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    free(block);
+}
+
+void operator delete[](void* block, size_t) noexcept {
+    free(block);
+}
+
+void operator delete(void* block, const nothrow_t&) noexcept {
+    free(block);
+}
+
+void operator delete[](void* block, const nothrow_t&) noexcept {
+    free(block);
+}
+
+void operator delete(void* block, align_val_t) noexcept {
+    freeAligned(block);
+}
+
+void operator delete[](void* block, align_val_t) noexcept {
+    freeAligned(block);
+}
+
+void operator delete(void* block, size_t, align_val_t) noexcept {
+    freeAligned(block);
+}
+
+void operator delete[](void* block, size_t, align_val_t) noexcept {
+    freeAligned(block);
+}
+
+void operator delete(void* block, align_val_t, const nothrow_t&) noexcept {
+    freeAligned(block);
+}
+
+void operator delete[](void* block, align_val_t, const nothrow_t&) noexcept {
+    freeAligned(block);
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+// Peak resident set size of the process so far, in kilobytes
+long peakRssKb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return static_cast<long>(counters.PeakWorkingSetSize / 1024);
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#endif
+}
+
+// Discards everything written to it, so status output is formatted but not printed
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override {
+        return c;
+    }
+
+    streamsize xsputn(const char*, streamsize count) override {
+        return count;
+    }
+};
+
+// Time and allocations spent in the measured parts of one case
+class Measurement {
+private:
+    chrono::steady_clock::time_point started;
+    uint64_t allocationsAtStart = 0;
+    double elapsedNs = 0;
+    uint64_t allocations = 0;
+
+public:
+    void start() {
+        allocationsAtStart = allocationCount.load(memory_order_relaxed);
+        started = chrono::steady_clock::now();
+    }
+
+    void stop() {
+        elapsedNs += chrono::duration<double, nano>(chrono::steady_clock::now() - started).count();
+        allocations += allocationCount.load(memory_order_relaxed) - allocationsAtStart;
+    }
+
+    double nanoseconds() const {
+        return elapsedNs;
+    }
+
+    uint64_t allocationTotal() const {
+        return allocations;
+    }
+};
+
+class JsonReport {
+private:
+    ostream& out;
+    bool first = true;
+
+public:
+    JsonReport(ostream& out, uint64_t seed) : out(out) {
+        out << "{\n  \"benchmark\": \"scheduling\",\n  \"seed\": " << seed << ",\n  \"results\": [";
+    }
+
+    void add(const char* operation, int patients, uint64_t ops, const Measurement& measurement) {
+        double perOp = ops > 0 ? 1.0 / ops : 0;
+        out << (first ? "\n" : ",\n") << "    {\"operation\": \"" << operation << "\", \"patients\": " << patients
+            << ", \"ops\": " << ops << fixed << setprecision(2)
+            << ", \"ns_per_op\": " << measurement.nanoseconds() * perOp
+            << ", \"allocs_per_op\": " << setprecision(4) << measurement.allocationTotal() * perOp
+            << ", \"peak_rss_kb\": " << peakRssKb() << "}";
+        out << defaultfloat;
+        out.flush();
+        first = false;
+    }
+
+    ~JsonReport() {
+        out << "\n  ]\n}\n";
+    }
+};
+
+// Doctors serve this many patients a minute in the serve and status cases, so a day empties the queues
+const int BENCHMARK_CAPACITY = 8192;
+
+// Populate one day, dispatch every minute of it, then serve the queues empty, and time the summary
+void benchmarkSchedulingDay(JsonReport& report, int patients, uint64_t seed) {
+    PatientSchedulingSystem<> system(seed);
+    system.setReportMode(ReportMode::SummaryOnly);
+    system.setKeepDonePatients(false);
+    system.setServiceCapacity(BENCHMARK_CAPACITY, BENCHMARK_CAPACITY);
+
+    Measurement populate;
+    populate.start();
+    system.populatePatients(patients);
+    populate.stop();
+    report.add("populate", patients, patients, populate);
+
+    Measurement dispatch;
+    dispatch.start();
+    for (int minute = 0; minute < MINUTES_PER_DAY; minute++) {
+        system.dispatchPatients(minute);
+    }
+    dispatch.stop();
+    report.add("dispatch", patients, system.dispatchedCount(), dispatch);
+
+    Measurement serve;
+    serve.start();
+    for (int minute = MINUTES_PER_DAY; system.hasWaitingPatients(); minute++) {
+        system.servePatients(minute);
+    }
+    serve.stop();
+    report.add("serve", patients, system.servedCount(), serve);
+
+    const int SUMMARY_REPEATS = 1000;
+    NullBuffer discard;
+    streambuf* console = cout.rdbuf(&discard);
+    Measurement summary;
+    summary.start();
+    for (int i = 0; i < SUMMARY_REPEATS; i++) {
+        system.displaySummary();
+    }
+    summary.stop();
+    cout.rdbuf(console);
+    report.add("summary", patients, SUMMARY_REPEATS, summary);
+}
+
+// Run a day minute by minute with change reporting on, timing only the per-minute status output.
+// Each operation is one reported arrival or service.
+void benchmarkStatus(JsonReport& report, int patients, uint64_t seed) {
+    PatientSchedulingSystem<> system(seed);
+    system.setReportMode(ReportMode::Changes);
+    system.setKeepDonePatients(false);
+    system.setServiceCapacity(BENCHMARK_CAPACITY, BENCHMARK_CAPACITY);
+    system.populatePatients(patients);
+
+    NullBuffer discard;
+    streambuf* console = cout.rdbuf(&discard);
+    Measurement status;
+    for (int minute = 0; minute < MINUTES_PER_DAY; minute++) {
+        system.dispatchPatients(minute);
+        system.servePatients(minute);
+        status.start();
+        system.displayStatus(minute);
+        status.stop();
+    }
+    cout.rdbuf(console);
+    report.add("status", patients, system.dispatchedCount() + system.servedCount(), status);
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t seed = 42;
+    int maxPatients = 10000000;
+    string outputPath;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--seed" && hasValue) {
+            seed = stoull(argv[++i]);
+        }
+        else if (arg == "--max-patients" && hasValue) {
+            maxPatients = stoi(argv[++i]);
+        }
+        else if (arg == "--output" && hasValue) {
+            outputPath = argv[++i];
+        }
+        else {
+            cerr << "Usage: " << argv[0] << " [--seed N] [--max-patients N] [--output FILE]\n";
+            return 1;
+        }
+    }
+
+    ofstream file;
+    if (!outputPath.empty()) {
+        file.open(outputPath);
+        if (!file) {
+            cerr << "Cannot write " << outputPath << "\n";
+            return 1;
+        }
+    }
+    {
+        JsonReport report(outputPath.empty() ? cout : file, seed);
+        for (int patients = 1000; patients <= maxPatients; patients *= 10) {
+            benchmarkSchedulingDay(report, patients, seed);
+            benchmarkStatus(report, patients, seed);
+        }
+    }
+    return 0;
+}
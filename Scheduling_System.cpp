@@ -7,217 +7,2663 @@
 #include <iomanip>
 #include <sstream>
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <array>
+#include <cmath>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <cstring>
+#include <cstddef>
+#include <climits>
+#include <type_traits>
+#include <fstream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <thread>
 
 using namespace std;
 
-// Class to represent a patient
-class Patient {
-public:
-    string id;
-    char gender;       // 'M' or 'F'
-    string arrivalTime; // HH:MM
-    string type;       // "Urgent" or "Normal"
-    int waitTime;      // Total time waited in minutes
+const int MINUTES_PER_DAY = 24 * 60;
+
+// Format minutes since the start of the simulation as HH:MM, prefixed with the day after the first one
+string formatTime(int minute) {
+    int day = minute / MINUTES_PER_DAY;
+    int hours = minute % MINUTES_PER_DAY / 60;
+    int minutes = minute % 60;
+    ostringstream oss;
+    if (day > 0) {
+        oss << "Day " << day + 1 << " ";
+    }
+    oss << setw(2) << setfill('0') << hours << ":" << setw(2) << setfill('0') << minutes;
+    return oss.str();
+}
+
+const uint64_t NATIONAL_ID_LIMIT = 100000000000000ULL; // 10^14, one past the largest 14-digit ID
+
+enum class PatientType : uint8_t { Urgent, Normal };
+enum class Gender : uint8_t { Male, Female };
+
+// Class to represent a patient, packed into 16 bytes so queues move plain values
+class Patient {
+public:
+    uint64_t id;            // Egyptian National ID (14 digits)
+    uint32_t arrivalMinute; // Minutes since the start of the simulation
+    uint16_t waitTime;      // Total time waited in minutes
+    PatientType type;
+    Gender gender;
+
+    Patient() : Patient(0, Gender::Male, 0, PatientType::Normal) {}
+
+    Patient(uint64_t id, Gender gender, uint32_t arrivalMinute, PatientType type)
+        : id(id), arrivalMinute(arrivalMinute), waitTime(0), type(type), gender(gender) {}
+
+    // Validates Egyptian National ID format (14 digits)
+    static bool validateID(uint64_t id) {
+        return id < NATIONAL_ID_LIMIT;
+    }
+
+    // National ID as the 14-digit string printed on the card
+    string idString() const {
+        ostringstream oss;
+        oss << setw(14) << setfill('0') << id;
+        return oss.str();
+    }
+
+    const char* typeName() const {
+        return type == PatientType::Urgent ? "Urgent" : "Normal";
+    }
+};
+
+static_assert(sizeof(Patient) == 16, "Patient should stay packed into 16 bytes");
+static_assert(is_trivially_copyable<Patient>::value, "Patients are copied byte for byte to and from traces");
+
+// Read-only memory map of a whole file
+class MappedFile {
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        close();
+    }
+
+    bool open(const string& path) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        length = static_cast<size_t>(fileSize.QuadPart);
+        if (length == 0) return true;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        bytes = mapping ? static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            return false;
+        }
+        length = static_cast<size_t>(info.st_size);
+        if (length == 0) {
+            ::close(fd);
+            return true;
+        }
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // The mapping keeps the file alive
+        bytes = mapped == MAP_FAILED ? nullptr : static_cast<const char*>(mapped);
+        if (bytes) madvise(const_cast<char*>(bytes), length, MADV_SEQUENTIAL);
+#endif
+        if (!bytes) close();
+        return bytes != nullptr;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (bytes) UnmapViewOfFile(bytes);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (bytes) munmap(const_cast<char*>(bytes), length);
+#endif
+        bytes = nullptr;
+        length = 0;
+    }
+
+    const char* data() const {
+        return bytes;
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    // Let the OS drop the pages before an offset, which are not read again
+    void release(size_t offset) {
+#ifndef _WIN32
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t end = offset / page * page;
+        if (bytes && end > 0) madvise(const_cast<char*>(bytes), end, MADV_DONTNEED);
+#endif
+    }
+};
+
+// Binary traces start with this header, followed by `count` patients stored byte for byte
+// (16 bytes each, little-endian as written on x86 and ARM)
+struct TraceHeader {
+    char magic[4];    // "PTRC"
+    uint32_t version;
+    uint64_t count;
+};
+
+const char TRACE_MAGIC[4] = { 'P', 'T', 'R', 'C' };
+const uint32_t TRACE_VERSION = 1;
+
+// Streams arrivals from a CSV or binary trace without loading it: each record is parsed only when
+// the simulation reaches it, and pages already read are handed back to the OS.
+// CSV lines are "id,gender,arrival,type" with the arrival as minutes since the start or HH:MM,
+// gender M or F and type Urgent or Normal; a header line is skipped. Arrivals must not decrease.
+class TraceReader {
+private:
+    static const size_t RELEASE_INTERVAL = 16 << 20;
+
+    MappedFile file;
+    bool binary = false;
+    size_t offset = 0;
+    size_t releasedUpTo = 0;
+    uint64_t recordsLeft = 0; // Binary traces only
+    uint64_t recordsRead = 0;
+    size_t lineNumber = 0;
+    Patient lookahead;
+    bool hasLookahead = false;
+    string errorMessage;
+
+    bool fail(const string& message) {
+        errorMessage = message;
+        offset = file.size();
+        recordsLeft = 0;
+        return false;
+    }
+
+    // False if there are no digits or the number does not fit in 64 bits
+    static bool parseNumber(const char*& cursor, const char* end, uint64_t& value) {
+        const char* start = cursor;
+        value = 0;
+        while (cursor < end && *cursor >= '0' && *cursor <= '9') {
+            uint64_t digit = static_cast<uint64_t>(*cursor++ - '0');
+            if (value > (UINT64_MAX - digit) / 10) return false;
+            value = value * 10 + digit;
+        }
+        return cursor > start;
+    }
+
+    bool parseLine(const char* cursor, const char* end, Patient& patient) {
+        uint64_t id, arrival, minutes;
+        if (!parseNumber(cursor, end, id) || !Patient::validateID(id) || cursor == end || *cursor++ != ',') {
+            return fail("bad patient ID on line " + to_string(lineNumber));
+        }
+        if (cursor == end || (*cursor != 'M' && *cursor != 'F')) {
+            return fail("bad gender on line " + to_string(lineNumber));
+        }
+        Gender gender = *cursor == 'M' ? Gender::Male : Gender::Female;
+        while (cursor < end && *cursor != ',') cursor++;
+        if (cursor == end || !parseNumber(++cursor, end, arrival)) {
+            return fail("bad arrival time on line " + to_string(lineNumber));
+        }
+        if (cursor < end && *cursor == ':') {
+            if (!parseNumber(++cursor, end, minutes) || minutes >= 60) {
+                return fail("bad arrival time on line " + to_string(lineNumber));
+            }
+            arrival = arrival * 60 + minutes;
+        }
+        if (arrival > UINT32_MAX || cursor == end || *cursor++ != ',' || cursor == end) {
+            return fail("bad arrival time on line " + to_string(lineNumber));
+        }
+        bool urgent = *cursor == 'U' || *cursor == 'u';
+        if (!urgent && *cursor != 'N' && *cursor != 'n') return fail("bad patient type on line " + to_string(lineNumber));
+        PatientType type = urgent ? PatientType::Urgent : PatientType::Normal;
+        patient = Patient(id, gender, static_cast<uint32_t>(arrival), type);
+        return true;
+    }
+
+    bool readCsv(Patient& patient) {
+        const char* data = file.data();
+        while (offset < file.size()) {
+            const char* start = data + offset;
+            const char* newline = static_cast<const char*>(memchr(start, '\n', file.size() - offset));
+            const char* end = newline ? newline : data + file.size();
+            offset = end - data + (newline ? 1 : 0);
+            lineNumber++;
+            if (end > start && end[-1] == '\r') end--;
+            if (end == start) continue;
+            if (lineNumber == 1 && (*start < '0' || *start > '9')) continue; // Header
+            return parseLine(start, end, patient);
+        }
+        return false;
+    }
+
+    // Fields are checked as the CSV path checks them before any byte is taken as an enum
+    bool readBinary(Patient& patient) {
+        if (recordsLeft == 0) return false;
+        const char* record = file.data() + offset;
+        uint64_t id;
+        uint32_t arrival;
+        uint8_t gender, type;
+        memcpy(&id, record + offsetof(Patient, id), sizeof(id));
+        memcpy(&arrival, record + offsetof(Patient, arrivalMinute), sizeof(arrival));
+        memcpy(&gender, record + offsetof(Patient, gender), sizeof(gender));
+        memcpy(&type, record + offsetof(Patient, type), sizeof(type));
+        if (!Patient::validateID(id)) return fail("bad patient ID in record " + to_string(recordsRead + 1));
+        if (gender > static_cast<uint8_t>(Gender::Female)) return fail("bad gender in record " + to_string(recordsRead + 1));
+        if (type > static_cast<uint8_t>(PatientType::Normal)) return fail("bad patient type in record " + to_string(recordsRead + 1));
+        patient = Patient(id, static_cast<Gender>(gender), arrival, static_cast<PatientType>(type));
+        offset += sizeof(Patient);
+        recordsLeft--;
+        return true;
+    }
+
+public:
+    bool open(const string& path) {
+        if (!file.open(path)) return fail("cannot open " + path);
+        TraceHeader header;
+        binary = file.size() >= sizeof(header) && memcmp(file.data(), TRACE_MAGIC, sizeof(TRACE_MAGIC)) == 0;
+        if (binary) {
+            memcpy(&header, file.data(), sizeof(header));
+            if (header.version != TRACE_VERSION) return fail("unsupported trace version in " + path);
+            if (header.count > (file.size() - sizeof(header)) / sizeof(Patient)) return fail(path + " is truncated");
+            offset = sizeof(header);
+            recordsLeft = header.count;
+        }
+        return true;
+    }
+
+    // Error that stopped the replay, empty if none
+    const string& error() const {
+        return errorMessage;
+    }
+
+    uint64_t count() const {
+        return recordsRead;
+    }
+
+    // Arrival minute of the next record without consuming it; false at the end of the trace
+    bool peek(uint32_t& minute) {
+        if (!hasLookahead) {
+            uint32_t previous = lookahead.arrivalMinute;
+            hasLookahead = binary ? readBinary(lookahead) : readCsv(lookahead);
+            if (hasLookahead && recordsRead > 0 && lookahead.arrivalMinute < previous) {
+                hasLookahead = false;
+                return fail("arrivals are not in time order at record " + to_string(recordsRead + 1));
+            }
+            if (offset - releasedUpTo >= RELEASE_INTERVAL) {
+                file.release(offset);
+                releasedUpTo = offset;
+            }
+        }
+        if (hasLookahead) minute = lookahead.arrivalMinute;
+        return hasLookahead;
+    }
+
+    // Consume the record returned by the last successful peek
+    Patient take() {
+        hasLookahead = false;
+        recordsRead++;
+        return lookahead;
+    }
+};
+
+// Binary checkpoints start with this header; the sections that follow are written and read by the
+// same code in PatientSchedulingSystem, so they only load into a build of the same program
+const char CHECKPOINT_MAGIC[4] = { 'P', 'C', 'K', 'P' };
+const uint32_t CHECKPOINT_VERSION = 3;
+
+// Writes checkpoint fields byte for byte; arrays are prefixed with their length
+class CheckpointWriter {
+private:
+    ofstream file;
+
+public:
+    bool open(const string& path) {
+        file.open(path, ios::binary | ios::trunc);
+        if (!file) return false;
+        file.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+        field(CHECKPOINT_VERSION);
+        return static_cast<bool>(file);
+    }
+
+    template <typename T>
+    bool field(const T& value) {
+        static_assert(is_trivially_copyable<T>::value, "checkpoint fields are copied byte for byte");
+        return static_cast<bool>(file.write(reinterpret_cast<const char*>(&value), sizeof(T)));
+    }
+
+    template <typename T>
+    void array(const T* values, size_t count) {
+        static_assert(is_trivially_copyable<T>::value, "checkpoint fields are copied byte for byte");
+        field(static_cast<uint64_t>(count));
+        file.write(reinterpret_cast<const char*>(values), count * sizeof(T));
+    }
+
+    template <typename T>
+    void array(const vector<T>& values) {
+        array(values.data(), values.size());
+    }
+
+    void text(const string& value) {
+        array(value.data(), value.size());
+    }
+
+    bool close() {
+        file.close();
+        return !file.fail();
+    }
+};
+
+// Reads a checkpoint through a memory map, so restoring is a bounds check and a copy per array.
+// The first field that does not fit marks the whole read as failed.
+class CheckpointReader {
+private:
+    MappedFile file;
+    size_t offset = 0;
+    bool failed = false;
+
+    bool take(void* out, size_t bytes) {
+        if (failed || file.size() - offset < bytes) {
+            failed = true;
+            return false;
+        }
+        memcpy(out, file.data() + offset, bytes);
+        offset += bytes;
+        return true;
+    }
+
+public:
+    // False if the file is missing or is not a checkpoint of this version
+    bool open(const string& path) {
+        char magic[sizeof(CHECKPOINT_MAGIC)];
+        uint32_t version = 0;
+        failed = !file.open(path) || !take(magic, sizeof(magic)) || memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0
+            || !field(version) || version != CHECKPOINT_VERSION;
+        return !failed;
+    }
+
+    template <typename T>
+    bool field(T& value) {
+        static_assert(is_trivially_copyable<T>::value, "checkpoint fields are copied byte for byte");
+        return take(&value, sizeof(T));
+    }
+
+    // A bool is read as a byte and must be 0 or 1; any other byte marks the read as failed
+    bool field(bool& value) {
+        uint8_t byte = 0;
+        if (!take(&byte, sizeof(byte))) return false;
+        if (byte > 1) failed = true;
+        value = byte == 1;
+        return !failed;
+    }
+
+    template <typename T>
+    bool array(vector<T>& values) {
+        static_assert(is_trivially_copyable<T>::value, "checkpoint fields are copied byte for byte");
+        uint64_t count = 0;
+        if (!field(count)) return false;
+        if (count > (file.size() - offset) / sizeof(T)) {
+            failed = true;
+            return false;
+        }
+        values.resize(count);
+        return take(values.data(), count * sizeof(T));
+    }
+
+    bool text(string& value) {
+        vector<char> chars;
+        if (!array(chars)) return false;
+        value.assign(chars.begin(), chars.end());
+        return true;
+    }
+
+    bool ok() const {
+        return !failed;
+    }
+
+    // Whether every byte of the file was read
+    bool atEnd() const {
+        return offset == file.size();
+    }
+};
+
+// The workload a checkpointed run was generated with, stored so --resume continues the same run.
+// Written field by field, so no padding bytes reach the file.
+struct RunSettings {
+    int32_t patientsPerDay;
+    uint64_t seed;
+
+    void save(CheckpointWriter& out) const {
+        out.field(patientsPerDay);
+        out.field(seed);
+    }
+
+    bool load(CheckpointReader& in) {
+        return in.field(patientsPerDay) && in.field(seed) && patientsPerDay >= 0;
+    }
+};
+
+// SplitMix64 step, used to expand one seed into well-mixed generator state
+inline uint64_t splitMix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// xoshiro256** generator: each simulation owns one, so runs are reproducible from their seed
+class Xoshiro256 {
+private:
+    uint64_t state[4];
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+public:
+    explicit Xoshiro256(uint64_t seed) {
+        for (auto& word : state) {
+            word = splitMix64(seed);
+        }
+    }
+
+    void save(CheckpointWriter& out) const {
+        out.field(state);
+    }
+
+    bool load(CheckpointReader& in) {
+        return in.field(state);
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(state[1] * 5, 7) * 9;
+        uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+    }
+
+    // Uniform integer in [0, bound)
+    uint64_t below(uint64_t bound) {
+        return next() % bound;
+    }
+};
+
+// Index of the highest set bit of a non-zero value
+inline int highestBit(uint64_t value) {
+    int bit = 0;
+    for (int step = 32; step > 0; step /= 2) {
+        if (value >> step) {
+            value >>= step;
+            bit += step;
+        }
+    }
+    return bit;
+}
+
+// Fixed-memory log-linear histogram in the style of HDR Histogram: values below 128 are exact,
+// larger values fall into 64 sub-buckets per power of two (under 1.6% relative error). Its 3776 counters
+// take about 30 KB.
+class LatencyHistogram {
+private:
+    static const int SUB_BUCKET_BITS = 7;
+    static const uint64_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static const uint64_t SUB_BUCKET_HALF = SUB_BUCKET_COUNT / 2;
+    static const int BUCKET_COUNT = SUB_BUCKET_COUNT + (64 - SUB_BUCKET_BITS) * SUB_BUCKET_HALF;
+
+    array<uint64_t, BUCKET_COUNT> counts{};
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t maxValue = 0;
+
+    static int bucketIndex(uint64_t value) {
+        if (value < SUB_BUCKET_COUNT) return static_cast<int>(value);
+        int shift = highestBit(value) - SUB_BUCKET_BITS + 1;
+        return static_cast<int>(SUB_BUCKET_COUNT + (shift - 1) * SUB_BUCKET_HALF + (value >> shift) - SUB_BUCKET_HALF);
+    }
+
+    // Largest value that falls into the same bucket
+    static uint64_t bucketUpperBound(int index) {
+        if (index < static_cast<int>(SUB_BUCKET_COUNT)) return index;
+        int shift = static_cast<int>((index - SUB_BUCKET_COUNT) / SUB_BUCKET_HALF) + 1;
+        uint64_t subBucket = (index - SUB_BUCKET_COUNT) % SUB_BUCKET_HALF + SUB_BUCKET_HALF;
+        return ((subBucket + 1) << shift) - 1;
+    }
+
+public:
+    void record(uint64_t value) {
+        counts[bucketIndex(value)]++;
+        total++;
+        sum += value;
+        maxValue = max(maxValue, value);
+    }
+
+    uint64_t count() const {
+        return total;
+    }
+
+    uint64_t maximum() const {
+        return maxValue;
+    }
+
+    double mean() const {
+        return total > 0 ? static_cast<double>(sum) / total : 0;
+    }
+
+    // Only the buckets in use are stored
+    void save(CheckpointWriter& out) const {
+        vector<uint32_t> used;
+        vector<uint64_t> usedCounts;
+        for (int i = 0; i < BUCKET_COUNT; i++) {
+            if (counts[i] == 0) continue;
+            used.push_back(i);
+            usedCounts.push_back(counts[i]);
+        }
+        out.field(total);
+        out.field(sum);
+        out.field(maxValue);
+        out.array(used);
+        out.array(usedCounts);
+    }
+
+    bool load(CheckpointReader& in) {
+        vector<uint32_t> used;
+        vector<uint64_t> usedCounts;
+        if (!in.field(total) || !in.field(sum) || !in.field(maxValue) || !in.array(used) || !in.array(usedCounts)) return false;
+        if (used.size() != usedCounts.size()) return false;
+        counts.fill(0);
+        for (size_t i = 0; i < used.size(); i++) {
+            if (used[i] >= static_cast<uint32_t>(BUCKET_COUNT)) return false;
+            counts[used[i]] = usedCounts[i];
+        }
+        return true;
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (int i = 0; i < BUCKET_COUNT; i++) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        sum += other.sum;
+        maxValue = max(maxValue, other.maxValue);
+    }
+
+    // Smallest recorded value that at least the given percentage of samples do not exceed
+    uint64_t percentile(double percent) const {
+        if (total == 0) return 0;
+        uint64_t target = max<uint64_t>(1, static_cast<uint64_t>(ceil(percent / 100.0 * total)));
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKET_COUNT; i++) {
+            seen += counts[i];
+            if (seen >= target) return min(bucketUpperBound(i), maxValue);
+        }
+        return maxValue;
+    }
+};
+
+// Bounded lock-free multi-producer, single-consumer ring of arriving patients. Each cell carries a
+// sequence number: producers claim a position with one compare-and-swap and publish the cell by
+// advancing its sequence; the single consumer reads published cells in order and hands them back.
+class IntakeRing {
+private:
+    struct Cell {
+        atomic<size_t> sequence;
+        Patient patient;
+    };
+
+    unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(64) atomic<size_t> tail{ 0 }; // Next position claimed by a producer
+    alignas(64) size_t head = 0;          // Next position read by the consumer
+
+public:
+    // The capacity is rounded up to a power of two
+    explicit IntakeRing(size_t capacity) {
+        size_t size = size_t(1) << (highestBit(max<size_t>(capacity, 2) - 1) + 1);
+        cells.reset(new Cell[size]);
+        mask = size - 1;
+        for (size_t i = 0; i < size; i++) cells[i].sequence.store(i, memory_order_relaxed);
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+    // Any thread: false when the ring is full
+    bool tryPush(const Patient& patient) {
+        size_t position = tail.load(memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[position & mask];
+            size_t sequence = cell.sequence.load(memory_order_acquire);
+            intptr_t lag = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (lag == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+                    cell.patient = patient;
+                    cell.sequence.store(position + 1, memory_order_release);
+                    return true;
+                }
+            }
+            else if (lag < 0) {
+                return false; // The consumer has not freed this cell yet
+            }
+            else {
+                position = tail.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer only: copy out up to maxCount published patients in submission order
+    size_t popBatch(Patient* out, size_t maxCount) {
+        size_t taken = 0;
+        while (taken < maxCount) {
+            Cell& cell = cells[head & mask];
+            if (cell.sequence.load(memory_order_acquire) != head + 1) break;
+            out[taken++] = cell.patient;
+            cell.sequence.store(head + mask + 1, memory_order_release);
+            head++;
+        }
+        return taken;
+    }
+};
+
+const uint32_t NO_POSITION = UINT32_MAX;
+
+// Indexed 4-ary min-heap of patient handles that supports O(log n) key updates and removal by handle.
+// Entries carry their keys so sifting stays inside one array. Where each handle sits is recorded in a
+// position table shared by all heaps of a system, since a handle lives in only one heap at a time.
+class IndexedHeap {
+private:
+    struct Entry {
+        uint64_t key;
+        uint32_t handle;
+    };
+
+    static const size_t ARITY = 4;
+    vector<Entry> entries;
+    vector<uint32_t>* positions;
+
+    void place(size_t index, const Entry& entry) {
+        entries[index] = entry;
+        (*positions)[entry.handle] = static_cast<uint32_t>(index);
+    }
+
+    void siftUp(size_t index) {
+        Entry entry = entries[index];
+        while (index > 0) {
+            size_t parent = (index - 1) / ARITY;
+            if (entries[parent].key <= entry.key) break;
+            place(index, entries[parent]);
+            index = parent;
+        }
+        place(index, entry);
+    }
+
+    void siftDown(size_t index) {
+        Entry entry = entries[index];
+        while (true) {
+            size_t first = index * ARITY + 1;
+            if (first >= entries.size()) break;
+            size_t best = first;
+            size_t last = min(first + ARITY, entries.size());
+            for (size_t child = first + 1; child < last; child++) {
+                if (entries[child].key < entries[best].key) best = child;
+            }
+            if (entries[best].key >= entry.key) break;
+            place(index, entries[best]);
+            index = best;
+        }
+        place(index, entry);
+    }
+
+    // Remove the entry at a heap index, filling the hole with the last entry
+    void removeAt(size_t index) {
+        (*positions)[entries[index].handle] = NO_POSITION;
+        Entry last = entries.back();
+        entries.pop_back();
+        if (index == entries.size()) return;
+        entries[index] = last;
+        if (index > 0 && entries[(index - 1) / ARITY].key > last.key) siftUp(index);
+        else siftDown(index);
+    }
+
+public:
+    explicit IndexedHeap(vector<uint32_t>& positions) : positions(&positions) {}
+
+    bool empty() const {
+        return entries.empty();
+    }
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    uint32_t top() const {
+        return entries.front().handle;
+    }
+
+    void push(uint32_t handle, uint64_t key) {
+        entries.push_back({ key, handle });
+        siftUp(entries.size() - 1);
+    }
+
+    void pop() {
+        removeAt(0);
+    }
+
+    void erase(uint32_t handle) {
+        removeAt((*positions)[handle]);
+    }
+
+    // Entries are stored in heap order, so a restored heap pops in exactly the same order
+    void save(CheckpointWriter& out) const {
+        out.array(entries);
+    }
+
+    // Restore the entries and record their positions; false if a handle is out of range or already placed
+    bool load(CheckpointReader& in) {
+        if (!in.array(entries)) return false;
+        for (size_t i = 0; i < entries.size(); i++) {
+            uint32_t handle = entries[i].handle;
+            if (handle >= positions->size() || (*positions)[handle] != NO_POSITION) return false;
+            (*positions)[handle] = static_cast<uint32_t>(i);
+        }
+        return true;
+    }
+
+    // Change a handle's key, moving it up for a decrease and down for an increase
+    void updateKey(uint32_t handle, uint64_t key) {
+        size_t index = (*positions)[handle];
+        uint64_t old = entries[index].key;
+        entries[index].key = key;
+        if (key < old) siftUp(index);
+        else siftDown(index);
+    }
+};
+
+enum class ArrivalDistribution {
+    Uniform,   // Every minute of the day equally likely, as with the original rand() % 24 and % 60
+    Poisson,   // Poisson process with a constant rate of count per day
+    TimeOfDay  // Poisson process whose rate follows the clinic's hourly load curve
+};
+
+// Bulk generator of synthetic patients. Every distribution yields a day's patients already in
+// arrival order, so they can be streamed to a trace or queued without sorting.
+class WorkloadGenerator {
+private:
+    // Relative arrival rate for each hour of the day: quiet nights, a morning peak and an evening peak
+    static constexpr double HOURLY_LOAD[24] = {
+        1, 1, 1, 1, 1, 2, 4, 7, 10, 12, 12, 11, 9, 8, 8, 8, 9, 10, 10, 8, 6, 4, 3, 2
+    };
+
+    Xoshiro256 rng;
+    ArrivalDistribution distribution;
+    vector<uint32_t> minuteCounts;
+
+    // Uniform double in [0, 1)
+    double unit() {
+        return (rng.next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // Exponentially distributed gap with mean 1
+    double exponential() {
+        return -log(1.0 - unit());
+    }
+
+    Patient randomPatient(uint32_t arrivalMinute) {
+        uint64_t bits = rng.next();
+        uint64_t id = rng.below(NATIONAL_ID_LIMIT);
+        return Patient(id, (bits & 1) ? Gender::Female : Gender::Male, arrivalMinute,
+            (bits & 2) ? PatientType::Normal : PatientType::Urgent);
+    }
+
+public:
+    WorkloadGenerator(uint64_t seed, ArrivalDistribution distribution)
+        : rng(seed), distribution(distribution), minuteCounts(MINUTES_PER_DAY) {}
+
+    void setDistribution(ArrivalDistribution kind) {
+        distribution = kind;
+    }
+
+    void save(CheckpointWriter& out) const {
+        rng.save(out);
+        out.field(distribution);
+    }
+
+    bool load(CheckpointReader& in) {
+        return rng.load(in) && in.field(distribution) && distribution >= ArrivalDistribution::Uniform
+            && distribution <= ArrivalDistribution::TimeOfDay;
+    }
+
+    // Generate one day of arrivals in time order, passing each patient to the sink. Uniform days
+    // have exactly `count` patients; Poisson days have `count` on average.
+    template <typename Sink>
+    void generateDay(int count, int day, Sink&& sink) {
+        uint32_t dayStart = static_cast<uint32_t>(day) * MINUTES_PER_DAY;
+        if (count <= 0) return;
+
+        if (distribution == ArrivalDistribution::Uniform) {
+            fill(minuteCounts.begin(), minuteCounts.end(), 0);
+            for (int i = 0; i < count; i++) {
+                minuteCounts[rng.below(MINUTES_PER_DAY)]++;
+            }
+            for (uint32_t minute = 0; minute < MINUTES_PER_DAY; minute++) {
+                for (uint32_t i = 0; i < minuteCounts[minute]; i++) {
+                    sink(randomPatient(dayStart + minute));
+                }
+            }
+            return;
+        }
+
+        // Walk the day in units of expected arrivals: exponential gaps of mean 1 in that space are a
+        // Poisson process, mapped back to minutes through each hour's share of the day's load
+        double totalLoad = 0;
+        for (double load : HOURLY_LOAD) totalLoad += load;
+        double position = exponential();
+        for (int hour = 0; hour < 24; hour++) {
+            double hourLoad = distribution == ArrivalDistribution::Poisson ? 1.0 / 24 : HOURLY_LOAD[hour] / totalLoad;
+            double hourArrivals = hourLoad * count;
+            while (position < hourArrivals) {
+                uint32_t minute = hour * 60 + static_cast<uint32_t>(position / hourArrivals * 60);
+                sink(randomPatient(dayStart + minute));
+                position += exponential();
+            }
+            position -= hourArrivals;
+        }
+    }
+};
+
+constexpr double WorkloadGenerator::HOURLY_LOAD[24];
+
+// Write exactly `digits` decimal digits of a value, two at a time, and return the end of the output
+inline char* writeDigits(char* out, uint64_t value, int digits) {
+    static const char PAIRS[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    char* end = out + digits;
+    char* cursor = end;
+    while (digits >= 2) {
+        cursor -= 2;
+        memcpy(cursor, PAIRS + (value % 100) * 2, 2);
+        value /= 100;
+        digits -= 2;
+    }
+    if (digits) *--cursor = static_cast<char>('0' + value % 10);
+    return end;
+}
+
+inline int digitCount(uint64_t value) {
+    int digits = 1;
+    while (value >= 10) {
+        value /= 10;
+        digits++;
+    }
+    return digits;
+}
+
+// Buffered text output: everything is collected in one large buffer and handed to the stream in big blocks
+class OutputSink {
+private:
+    static const size_t BUFFER_SIZE = 1 << 20;
+    static const size_t FIRST_BUFFER_SIZE = 4096;
+
+    ostream& out;
+    // Grows on demand up to BUFFER_SIZE, so a sink that only writes a summary, or nothing at all,
+    // never allocates the full buffer
+    vector<char> buffer;
+    size_t used = 0;
+    bool unflushed = false; // Something reached `out` since the last flush
+
+    void append(const char* text, size_t length) {
+        if (used + length > buffer.size() && buffer.size() < BUFFER_SIZE) {
+            buffer.resize(min(BUFFER_SIZE, max({ used + length, buffer.size() * 2, FIRST_BUFFER_SIZE })));
+        }
+        if (used + length > buffer.size()) {
+            flush();
+            if (length > buffer.size()) {
+                out.write(text, length);
+                unflushed = true;
+                return;
+            }
+        }
+        memcpy(buffer.data() + used, text, length);
+        used += length;
+    }
+
+public:
+    explicit OutputSink(ostream& out) : out(out) {}
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    ~OutputSink() {
+        flush();
+    }
+
+    OutputSink& operator<<(const char* text) {
+        append(text, strlen(text));
+        return *this;
+    }
+
+    OutputSink& operator<<(const string& text) {
+        append(text.data(), text.size());
+        return *this;
+    }
+
+    OutputSink& operator<<(char c) {
+        append(&c, 1);
+        return *this;
+    }
+
+    template <typename T>
+    typename enable_if<is_integral<T>::value, OutputSink&>::type operator<<(T value) {
+        char digits[24];
+        char* cursor = digits;
+        uint64_t magnitude = static_cast<uint64_t>(value);
+        if (is_signed<T>::value && value < 0) {
+            *cursor++ = '-';
+            magnitude = 0 - magnitude;
+        }
+        cursor = writeDigits(cursor, magnitude, digitCount(magnitude));
+        append(digits, cursor - digits);
+        return *this;
+    }
+
+    // Same formatting as cout's default for doubles
+    OutputSink& operator<<(double value) {
+        char text[32];
+        int length = snprintf(text, sizeof(text), "%g", value);
+        append(text, length);
+        return *this;
+    }
+
+    // Egyptian National ID zero-padded to 14 digits
+    void writeId(uint64_t id) {
+        char digits[14];
+        writeDigits(digits, id, 14);
+        append(digits, sizeof(digits));
+    }
+
+    // Flushes `out` only if something was written, so idle sinks do not touch it from other threads
+    void flush() {
+        if (used > 0) out.write(buffer.data(), used);
+        if (used > 0 || unflushed) out.flush();
+        used = 0;
+        unflushed = false;
+    }
+};
+
+enum class ReportMode {
+    Changes,    // One entry per simulated minute with its arrivals, services and queue depths
+    SummaryOnly // Nothing until the final summary, for batch runs
+};
+
+// Reports only what changed in each simulated minute, writing through one buffered sink
+class StatusReporter {
+private:
+    OutputSink sink;
+    ReportMode mode = ReportMode::Changes;
+    int minute = -1; // Minute whose changes are being collected
+    vector<Patient> arrived;
+    vector<pair<Patient, uint32_t>> served; // With the minutes each patient waited
+    size_t waitingUrgent = 0;
+    size_t waitingNormal = 0;
+    bool depthsChanged = false;
+
+    void startMinute(int next) {
+        if (next != minute) {
+            writeMinute(false);
+            minute = next;
+        }
+    }
+
+    void writeMinute(bool force) {
+        if (minute < 0 || (!force && !depthsChanged && arrived.empty() && served.empty())) return;
+        string stamp = "[" + formatTime(minute) + "] ";
+        if (!arrived.empty()) {
+            sink << stamp << "Arrived (" << arrived.size() << "):";
+            const char* separator = " ";
+            for (const auto& patient : arrived) {
+                sink << separator;
+                separator = ", ";
+                sink.writeId(patient.id);
+                sink << ' ' << patient.typeName();
+            }
+            sink << '\n';
+        }
+        if (!served.empty()) {
+            sink << stamp << "Served (" << served.size() << "):";
+            const char* separator = " ";
+            for (const auto& entry : served) {
+                sink << separator;
+                separator = ", ";
+                sink.writeId(entry.first.id);
+                sink << ' ' << entry.first.typeName() << " after " << entry.second << " min";
+            }
+            sink << '\n';
+        }
+        sink << stamp << "Waiting: " << waitingUrgent << " urgent, " << waitingNormal << " normal\n";
+        arrived.clear();
+        served.clear();
+        depthsChanged = false;
+    }
+
+public:
+    StatusReporter() : sink(cout) {}
+
+    void setMode(ReportMode reportMode) {
+        mode = reportMode;
+    }
+
+    // Summaries are written through the same buffer so they stay in order with the changes
+    OutputSink& output() {
+        return sink;
+    }
+
+    void patientArrived(int at, const Patient& patient) {
+        if (mode == ReportMode::SummaryOnly) return;
+        startMinute(at);
+        arrived.push_back(patient);
+    }
+
+    void patientServed(int at, const Patient& patient, uint32_t waited) {
+        if (mode == ReportMode::SummaryOnly) return;
+        startMinute(at);
+        served.emplace_back(patient, waited);
+    }
+
+    void queueDepths(int at, size_t urgent, size_t normal) {
+        if (mode == ReportMode::SummaryOnly) return;
+        startMinute(at);
+        depthsChanged |= urgent != waitingUrgent || normal != waitingNormal;
+        waitingUrgent = urgent;
+        waitingNormal = normal;
+    }
+
+    // Write the current minute's changes, or just the queue depths when nothing happened, and flush
+    void endMinute(int at) {
+        if (mode == ReportMode::SummaryOnly) return;
+        startMinute(at);
+        writeMinute(true);
+        sink.flush();
+    }
+
+    // Write whatever is still collected, e.g. before the summary
+    void finish() {
+        if (mode == ReportMode::Changes) writeMinute(false);
+    }
+};
+
+// Writes arrivals to a CSV or binary trace through one large buffer
+class TraceWriter {
+private:
+    static const size_t BUFFER_SIZE = 1 << 20;
+
+    ofstream file;
+    vector<char> buffer;
+    size_t used = 0;
+    bool binary;
+    uint64_t written = 0;
+
+    void flushBuffer() {
+        file.write(buffer.data(), used);
+        used = 0;
+    }
+
+    void ensureSpace(size_t bytes) {
+        if (used + bytes > buffer.size()) flushBuffer();
+    }
+
+    void appendDigits(uint64_t value, int digits) {
+        writeDigits(buffer.data() + used, value, digits);
+        used += digits;
+    }
+
+public:
+    // Binary unless the path ends in .csv
+    bool open(const string& path) {
+        binary = path.size() < 4 || path.compare(path.size() - 4, 4, ".csv") != 0;
+        file.open(path, ios::binary | ios::trunc);
+        buffer.resize(BUFFER_SIZE);
+        if (!file) return false;
+        if (binary) {
+            TraceHeader header = {};
+            memcpy(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+            header.version = TRACE_VERSION;
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header)); // Count is patched in close()
+        }
+        else {
+            file << "id,gender,arrival,type\n";
+        }
+        return true;
+    }
+
+    void write(const Patient& patient) {
+        if (binary) {
+            ensureSpace(sizeof(Patient));
+            memcpy(buffer.data() + used, &patient, sizeof(Patient));
+            used += sizeof(Patient);
+        }
+        else {
+            ensureSpace(40);
+            appendDigits(patient.id, 14);
+            buffer[used++] = ',';
+            buffer[used++] = patient.gender == Gender::Male ? 'M' : 'F';
+            buffer[used++] = ',';
+            appendDigits(patient.arrivalMinute, digitCount(patient.arrivalMinute));
+            buffer[used++] = ',';
+            memcpy(buffer.data() + used, patient.typeName(), 6);
+            used += 6;
+            buffer[used++] = '\n';
+        }
+        written++;
+    }
+
+    uint64_t count() const {
+        return written;
+    }
+
+    bool close() {
+        flushBuffer();
+        if (binary) {
+            file.seekp(offsetof(TraceHeader, count));
+            file.write(reinterpret_cast<const char*>(&written), sizeof(written));
+        }
+        file.close();
+        return !file.fail();
+    }
+};
+
+// Scheduling policies choose between the next urgent and the next normal patient. They are template
+// arguments of PatientSchedulingSystem, so the choice is inlined with no virtual dispatch.
+
+// Urgent patients always go first
+struct StrictPriorityPolicy {
+    static const char* name() { return "strict"; }
+    bool preferUrgent(const Patient&, const Patient&) const { return true; }
+    void served(PatientType) {}
+};
+
+// Priority grows with time waited, and urgent patients start URGENT_HEAD_START minutes ahead, so a
+// normal patient who has waited that much longer than an urgent one goes first
+struct AgingPolicy {
+    static const int URGENT_HEAD_START = 30;
+
+    static const char* name() { return "aging"; }
+    bool preferUrgent(const Patient& urgent, const Patient& normal) const {
+        return static_cast<int64_t>(urgent.arrivalMinute) - URGENT_HEAD_START <= static_cast<int64_t>(normal.arrivalMinute);
+    }
+    void served(PatientType) {}
+};
+
+// Stride scheduling: while both types are waiting, urgent patients get URGENT_WEIGHT of every
+// URGENT_WEIGHT + NORMAL_WEIGHT services
+struct WeightedFairPolicy {
+    static const uint64_t URGENT_WEIGHT = 3;
+    static const uint64_t NORMAL_WEIGHT = 1;
+    static const uint64_t STRIDE_SCALE = URGENT_WEIGHT * NORMAL_WEIGHT;
+    uint64_t urgentPass = 0;
+    uint64_t normalPass = 0;
+
+    static const char* name() { return "fair"; }
+    bool preferUrgent(const Patient&, const Patient&) const { return urgentPass <= normalPass; }
+    void served(PatientType type) {
+        if (type == PatientType::Urgent) urgentPass += STRIDE_SCALE / URGENT_WEIGHT;
+        else normalPass += STRIDE_SCALE / NORMAL_WEIGHT;
+    }
+};
+
+// Earliest deadline first, where each type has a target time to be seen after arrival
+struct EarliestDeadlinePolicy {
+    static const uint32_t URGENT_TARGET = 15;
+    static const uint32_t NORMAL_TARGET = 120;
+
+    static const char* name() { return "edf"; }
+    bool preferUrgent(const Patient& urgent, const Patient& normal) const {
+        return urgent.arrivalMinute + URGENT_TARGET <= normal.arrivalMinute + NORMAL_TARGET;
+    }
+    void served(PatientType) {}
+};
+
+enum class PolicyKind { StrictPriority, Aging, WeightedFair, EarliestDeadline };
+
+// Call a generic callable with the policy chosen at run time, instantiating it for that policy
+template <typename Body>
+int withPolicy(PolicyKind kind, Body&& body) {
+    switch (kind) {
+    case PolicyKind::Aging:
+        return body(AgingPolicy());
+    case PolicyKind::WeightedFair:
+        return body(WeightedFairPolicy());
+    case PolicyKind::EarliestDeadline:
+        return body(EarliestDeadlinePolicy());
+    default:
+        return body(StrictPriorityPolicy());
+    }
+}
+
+// A doctor with their own waiting queues and scheduling state. Both queues hold handles of waiting
+// patients keyed by arrival minute, then dispatch order, so the normal queue stays first come first served.
+template <typename Policy>
+struct Doctor {
+    IndexedHeap urgentQueue;
+    IndexedHeap normalQueue;
+    Policy policy;
+
+    explicit Doctor(vector<uint32_t>& positions) : urgentQueue(positions), normalQueue(positions) {}
+
+    IndexedHeap& queueFor(PatientType type) {
+        return type == PatientType::Urgent ? urgentQueue : normalQueue;
+    }
+};
+
+template <typename Policy = StrictPriorityPolicy>
+class PatientSchedulingSystem {
+private:
+    vector<Doctor<Policy>> doctors;
+    size_t nextDoctor = 0;      // Arrivals are handed to doctors round-robin
+    size_t waitingPatients = 0;
+    uint64_t stolenPatients = 0;
+    uint64_t escalatedPatients = 0;
+    uint64_t walkedOutPatients = 0;
+
+    // Waiting patients live in slots addressed by handle; the queues only hold handles
+    vector<Patient> waiting;
+    vector<uint32_t> heapPositions;    // Slot -> index in whichever heap holds it
+    vector<uint32_t> slotDoctors;      // Slot -> doctor whose queue holds it
+    vector<uint32_t> freeSlots;
+    unordered_map<uint64_t, uint32_t> handlesById; // Built on the first lookup by ID, then kept current
+    bool idIndexBuilt = false;
+    uint32_t dispatchSequence = 0;
+    vector<Patient> allPatients; // Pending arrivals, sorted by arrival minute from nextArrival on
+    vector<Patient> donePatients;
+    bool keepDonePatients = true;
+    uint64_t servedPatients = 0;
+    TraceReader* trace = nullptr; // Streamed arrivals, merged with allPatients
+    size_t nextArrival = 0;
+    bool arrivalIndexBuilt = true;
+
+    int totalUrgent = 0;
+    int totalNormal = 0;
+    double totalWaitTime = 0;
+    LatencyHistogram urgentWaits;
+    LatencyHistogram normalWaits;
+    Xoshiro256 rng;
+    WorkloadGenerator workload;
+    int minServicePerTick = 5;
+    int maxServicePerTick = 10;
+    StatusReporter reporter;
+    size_t waitingUrgent = 0;
+    unique_ptr<IntakeRing> intake;  // Live arrivals from registration desks on other threads
+    vector<Patient> intakeBatch;
+    static const size_t INTAKE_BATCH = 256;
+
+    // Counting-sort the pending patients by arrival minute, so each dispatch only touches due patients
+    void buildArrivalIndex() {
+        allPatients.erase(allPatients.begin(), allPatients.begin() + nextArrival);
+        nextArrival = 0;
+        arrivalIndexBuilt = true;
+        auto earlier = [](const Patient& a, const Patient& b) { return a.arrivalMinute < b.arrivalMinute; };
+        if (is_sorted(allPatients.begin(), allPatients.end(), earlier)) return; // Generated days already are
+
+        auto range = minmax_element(allPatients.begin(), allPatients.end(), earlier);
+        uint32_t firstMinute = range.first->arrivalMinute;
+        vector<size_t> bucketStart(range.second->arrivalMinute - firstMinute + 2, 0);
+        for (const auto& patient : allPatients) {
+            bucketStart[patient.arrivalMinute - firstMinute + 1]++;
+        }
+        for (size_t i = 1; i < bucketStart.size(); i++) {
+            bucketStart[i] += bucketStart[i - 1];
+        }
+
+        vector<Patient> sorted(allPatients.size());
+        for (const auto& patient : allPatients) {
+            sorted[bucketStart[patient.arrivalMinute - firstMinute]++] = patient;
+        }
+        allPatients.swap(sorted);
+    }
+
+    static uint64_t queueKey(uint32_t arrivalMinute, uint32_t sequence) {
+        return static_cast<uint64_t>(arrivalMinute) << 32 | sequence;
+    }
+
+    uint32_t allocateSlot(const Patient& patient, uint32_t doctorIndex) {
+        uint32_t handle;
+        if (freeSlots.empty()) {
+            handle = static_cast<uint32_t>(waiting.size());
+            waiting.push_back(patient);
+            heapPositions.push_back(NO_POSITION);
+            slotDoctors.push_back(doctorIndex);
+        }
+        else {
+            handle = freeSlots.back();
+            freeSlots.pop_back();
+            waiting[handle] = patient;
+            slotDoctors[handle] = doctorIndex;
+        }
+        if (idIndexBuilt) handlesById[patient.id] = handle;
+        return handle;
+    }
+
+    void releaseSlot(uint32_t handle) {
+        if (idIndexBuilt) {
+            auto found = handlesById.find(waiting[handle].id);
+            if (found != handlesById.end() && found->second == handle) handlesById.erase(found);
+        }
+        freeSlots.push_back(handle);
+        waitingPatients--;
+        if (waiting[handle].type == PatientType::Urgent) waitingUrgent--;
+    }
+
+    // Handle of a waiting patient by national ID, or NO_POSITION
+    uint32_t findWaiting(uint64_t id) {
+        if (!idIndexBuilt) {
+            for (uint32_t handle = 0; handle < waiting.size(); handle++) {
+                if (heapPositions[handle] != NO_POSITION) handlesById[waiting[handle].id] = handle;
+            }
+            idIndexBuilt = true;
+        }
+        auto found = handlesById.find(id);
+        return found == handlesById.end() ? NO_POSITION : found->second;
+    }
+
+    // Doctor other than the given one with the most waiting patients of a type, or -1 if none have any
+    int busiestDoctor(size_t except, PatientType type) const {
+        int busiest = -1;
+        size_t most = 0;
+        for (size_t i = 0; i < doctors.size(); i++) {
+            size_t waiting = type == PatientType::Urgent ? doctors[i].urgentQueue.size() : doctors[i].normalQueue.size();
+            if (i != except && waiting > most) {
+                busiest = static_cast<int>(i);
+                most = waiting;
+            }
+        }
+        return busiest;
+    }
+
+    // Next patient for a doctor. The policy picks between the doctor's next urgent patient (stolen from
+    // the busiest colleague when they have none of their own) and their own next normal patient.
+    // A doctor with no normal patients left steals them from the busiest colleague too.
+    bool takeNextPatient(size_t doctorIndex, Patient& patient) {
+        if (waitingPatients == 0) return false;
+        Doctor<Policy>& doctor = doctors[doctorIndex];
+        Doctor<Policy>* urgentSource = &doctor;
+        if (doctor.urgentQueue.empty()) {
+            int victim = busiestDoctor(doctorIndex, PatientType::Urgent);
+            urgentSource = victim >= 0 ? &doctors[victim] : nullptr;
+        }
+
+        bool takeUrgent = urgentSource != nullptr;
+        if (takeUrgent && !doctor.normalQueue.empty()) {
+            takeUrgent = doctor.policy.preferUrgent(waiting[urgentSource->urgentQueue.top()], waiting[doctor.normalQueue.top()]);
+            doctor.policy.served(takeUrgent ? PatientType::Urgent : PatientType::Normal);
+        }
+
+        IndexedHeap* source;
+        if (takeUrgent) {
+            source = &urgentSource->urgentQueue;
+            if (urgentSource != &doctor) stolenPatients++;
+        }
+        else if (doctor.normalQueue.empty()) {
+            int victim = busiestDoctor(doctorIndex, PatientType::Normal);
+            if (victim < 0) return false;
+            source = &doctors[victim].normalQueue;
+            stolenPatients++;
+        }
+        else {
+            source = &doctor.normalQueue;
+        }
+        uint32_t handle = source->top();
+        source->pop();
+        patient = waiting[handle];
+        releaseSlot(handle);
+        return true;
+    }
+
+    // Scalar state shared by saving and restoring a checkpoint
+    template <typename Archive>
+    bool checkpointCounters(Archive& archive) {
+        return archive.field(minServicePerTick) && archive.field(maxServicePerTick) && archive.field(keepDonePatients)
+            && archive.field(nextDoctor) && archive.field(waitingPatients) && archive.field(waitingUrgent)
+            && archive.field(stolenPatients) && archive.field(escalatedPatients) && archive.field(walkedOutPatients)
+            && archive.field(dispatchSequence) && archive.field(servedPatients) && archive.field(totalUrgent)
+            && archive.field(totalNormal) && archive.field(totalWaitTime);
+    }
+
+    // Whether restored slots, queues and counters agree with each other
+    bool checkpointConsistent() const {
+        if (nextDoctor >= doctors.size()) return false;
+        for (uint32_t doctorIndex : slotDoctors) {
+            if (doctorIndex >= doctors.size()) return false;
+        }
+        size_t queued = 0;
+        size_t urgent = 0;
+        for (const auto& doctor : doctors) {
+            queued += doctor.urgentQueue.size() + doctor.normalQueue.size();
+            urgent += doctor.urgentQueue.size();
+        }
+        for (uint32_t handle : freeSlots) {
+            if (handle >= waiting.size() || heapPositions[handle] != NO_POSITION) return false;
+        }
+        return queued == waitingPatients && urgent == waitingUrgent && queued + freeSlots.size() == waiting.size();
+    }
+
+public:
+    explicit PatientSchedulingSystem(uint64_t seed)
+        : rng(seed), workload(~seed, ArrivalDistribution::Uniform) {
+        setDoctorCount(1);
+    }
+
+    // Doctors' queues point into this system's position table
+    PatientSchedulingSystem(const PatientSchedulingSystem&) = delete;
+    PatientSchedulingSystem& operator=(const PatientSchedulingSystem&) = delete;
+
+    // Number of doctors serving in parallel; set before any patient is dispatched
+    void setDoctorCount(int count) {
+        doctors.clear();
+        for (int i = 0; i < max(1, count); i++) {
+            doctors.emplace_back(heapPositions);
+        }
+    }
+
+    int doctorCount() const {
+        return static_cast<int>(doctors.size());
+    }
+
+    // Report every minute's changes, or only the summary for batch runs
+    void setReportMode(ReportMode mode) {
+        reporter.setMode(mode);
+    }
+
+    // Range of patients each doctor can serve per minute
+    void setServiceCapacity(int minPerTick, int maxPerTick) {
+        minServicePerTick = minPerTick;
+        maxServicePerTick = max(minPerTick, maxPerTick);
+    }
+
+    // Randomly draw how many patients one doctor can serve this minute
+    int drawServiceCapacity() {
+        return minServicePerTick + static_cast<int>(rng.below(maxServicePerTick - minServicePerTick + 1));
+    }
+
+    const LatencyHistogram& waitHistogram(PatientType type) const {
+        return type == PatientType::Urgent ? urgentWaits : normalWaits;
+    }
+
+    size_t servedCount() const {
+        return servedPatients;
+    }
+
+    // Keep every served patient for the status display; long replays only count them
+    void setKeepDonePatients(bool enabled) {
+        keepDonePatients = enabled;
+    }
+
+    // Stream further arrivals from a trace as simulated time reaches them
+    void attachTrace(TraceReader& reader) {
+        trace = &reader;
+    }
+
+    // Accept live arrivals through a bounded ring; call before any desk thread submits
+    void openIntake(size_t capacity) {
+        intake.reset(new IntakeRing(capacity));
+        intakeBatch.resize(INTAKE_BATCH);
+    }
 
-    Patient(string id, char gender, string arrivalTime, string type)
-        : id(id), gender(gender), arrivalTime(arrivalTime), type(type), waitTime(0) {}
+    // Thread-safe: submit a patient arriving now. False when the intake is full (or not open) and the desk
+    // should retry after the next tick drains it.
+    bool submitPatient(const Patient& patient) {
+        return intake && intake->tryPush(patient);
+    }
 
-    // Validates Egyptian National ID format (14 digits)
-    static bool validateID(const string& id) {
-        return id.length() == 14 && all_of(id.begin(), id.end(), ::isdigit);
+    // Write the complete state at the given minute to a binary checkpoint: policy and workload settings,
+    // counters, random generators, wait histograms, every doctor's queues and policy state, pending arrivals
+    // and served patients. Patients still unread in an attached trace or in the intake ring are not included.
+    bool saveCheckpoint(const string& path, int minute, const RunSettings& settings) {
+        if (!arrivalIndexBuilt) buildArrivalIndex();
+        CheckpointWriter out;
+        if (!out.open(path)) return false;
+        out.text(Policy::name());
+        settings.save(out);
+        out.field(minute);
+        checkpointCounters(out);
+        rng.save(out);
+        workload.save(out);
+        urgentWaits.save(out);
+        normalWaits.save(out);
+        out.array(waiting);
+        out.array(slotDoctors);
+        out.array(freeSlots);
+        out.field(static_cast<uint64_t>(doctors.size()));
+        for (const auto& doctor : doctors) {
+            out.field(doctor.policy);
+            doctor.urgentQueue.save(out);
+            doctor.normalQueue.save(out);
+        }
+        out.array(allPatients.data() + nextArrival, allPatients.size() - nextArrival);
+        out.array(donePatients);
+        return out.close();
     }
-};
 
-// Comparator for prioritizing urgent patients in a priority queue
-struct UrgentPatientComparator {
-    bool operator()(const Patient& a, const Patient& b) const {
-        return a.arrivalTime > b.arrivalTime; // Patients with earlier arrival times are served first
+    // Replace this system's state with a checkpoint's, read through a memory map, and set `minute` to the
+    // minute it was taken at. On failure `error` says why, and the system must be discarded.
+    bool restoreCheckpoint(const string& path, int& minute, string& error) {
+        CheckpointReader in;
+        if (!in.open(path)) {
+            error = path + " is missing or is not a checkpoint";
+            return false;
+        }
+        string policyName;
+        RunSettings settings; // Applied to the options already, by resumeSettings
+        uint64_t doctorTotal = 0;
+        if (in.text(policyName) && policyName != Policy::name()) {
+            error = path + " was taken with the " + policyName + " policy";
+            return false;
+        }
+        bool loaded = settings.load(in) && in.field(minute) && checkpointCounters(in) && rng.load(in) && workload.load(in)
+            && urgentWaits.load(in) && normalWaits.load(in) && in.array(waiting) && in.array(slotDoctors)
+            && in.array(freeSlots) && in.field(doctorTotal) && doctorTotal > 0 && doctorTotal <= UINT32_MAX
+            && slotDoctors.size() == waiting.size();
+        if (loaded) {
+            setDoctorCount(static_cast<int>(doctorTotal));
+            heapPositions.assign(waiting.size(), NO_POSITION);
+            for (auto& doctor : doctors) {
+                loaded = loaded && in.field(doctor.policy) && doctor.urgentQueue.load(in) && doctor.normalQueue.load(in);
+            }
+        }
+        loaded = loaded && in.array(allPatients) && in.array(donePatients) && in.atEnd();
+        if (!loaded || !checkpointConsistent()) {
+            error = path + " is truncated or corrupt";
+            return false;
+        }
+        nextArrival = 0;
+        arrivalIndexBuilt = false; // Sorted already, so building the index is a single check
+        handlesById.clear();
+        idIndexBuilt = false;
+        return true;
     }
-};
 
-class PatientSchedulingSystem {
-private:
-    priority_queue<Patient, vector<Patient>, UrgentPatientComparator> urgentQueue;
-    queue<Patient> normalQueue;
-    vector<Patient> allPatients;
-    vector<Patient> donePatients;
+    int dispatchedCount() const {
+        return totalUrgent + totalNormal;
+    }
 
-    int totalUrgent = 0;
-    int totalNormal = 0;
-    double totalWaitTime = 0;
+    // Queue already generated patients, e.g. a shared trace, as pending arrivals
+    void addPatients(const vector<Patient>& patients) {
+        allPatients.insert(allPatients.end(), patients.begin(), patients.end());
+        arrivalIndexBuilt = false;
+    }
 
-    // Generate random time in HH:MM 24-hour format
-    string generateRandomTime() {
-        int hours = rand() % 24;
-        int minutes = rand() % 60;
-        ostringstream oss;
-        oss << setw(2) << setfill('0') << hours << ":" << setw(2) << setfill('0') << minutes;
-        return oss.str();
+    // Remove and return every pending arrival in arrival order
+    vector<Patient> takePendingPatients() {
+        if (!arrivalIndexBuilt) buildArrivalIndex();
+        allPatients.erase(allPatients.begin(), allPatients.begin() + nextArrival);
+        nextArrival = 0;
+        return move(allPatients);
     }
 
-    // Generate random ID (14 digits)
-    string generateRandomID() {
-        ostringstream oss;
-        for (int i = 0; i < 14; i++) {
-            oss << rand() % 10;
+    void setArrivalDistribution(ArrivalDistribution distribution) {
+        workload.setDistribution(distribution);
+    }
+
+    // Populate the list of patients with random data arriving on the given day
+    void populatePatients(int count, int day = 0) {
+        allPatients.reserve(allPatients.size() + max(count, 0));
+        workload.generateDay(count, day, [&](const Patient& patient) { allPatients.push_back(patient); });
+        arrivalIndexBuilt = false;
+    }
+
+    // Minute of the earliest pending arrival, or -1 when none are left
+    int nextArrivalMinute() {
+        if (!arrivalIndexBuilt) buildArrivalIndex();
+        int next = nextArrival < allPatients.size() ? static_cast<int>(allPatients[nextArrival].arrivalMinute) : -1;
+        uint32_t traced;
+        if (trace && trace->peek(traced) && (next < 0 || static_cast<int>(traced) < next)) {
+            next = static_cast<int>(traced);
         }
-        return oss.str();
+        return next;
     }
 
-    // Generate random type: "Urgent" or "Normal"
-    string generateRandomType() {
-        return rand() % 2 == 0 ? "Urgent" : "Normal";
+    // Whether any dispatched patient is still waiting to be served
+    bool hasWaitingPatients() const {
+        return waitingPatients > 0;
     }
 
-public:
-    // Populate the list of patients with random data
-    void populatePatients(int count) {
-        for (int i = 0; i < count; i++) {
-            string id = generateRandomID();
-            char gender = rand() % 2 == 0 ? 'M' : 'F';
-            string arrivalTime = generateRandomTime();
-            string type = generateRandomType();
+    // Dispatch patients to their respective queues based on the current time
+    void dispatchPatients(int currentMinute) {
+        if (!arrivalIndexBuilt) buildArrivalIndex();
+        while (nextArrival < allPatients.size() && static_cast<int>(allPatients[nextArrival].arrivalMinute) <= currentMinute) {
+            dispatchPatient(allPatients[nextArrival++], currentMinute);
+        }
+        if (nextArrival == allPatients.size() && nextArrival > 0) {
+            vector<Patient>().swap(allPatients); // Release the storage of dispatched patients
+            nextArrival = 0;
+        }
+        uint32_t traced;
+        while (trace && trace->peek(traced) && static_cast<int>(traced) <= currentMinute) {
+            dispatchPatient(trace->take(), currentMinute);
+        }
+        if (intake) drainIntake(currentMinute);
+        reporter.queueDepths(currentMinute, waitingUrgent, waitingPatients - waitingUrgent);
+    }
 
-            if (!Patient::validateID(id)) {
-                i--; // Skip invalid ID and regenerate
-                continue;
+    // Dispatch live arrivals in batches; at most one ring's worth per tick so busy desks cannot stall the clock.
+    // They arrive in the minute they are drained.
+    void drainIntake(int currentMinute) {
+        size_t budget = intake->capacity();
+        while (budget > 0) {
+            size_t taken = intake->popBatch(intakeBatch.data(), min(budget, INTAKE_BATCH));
+            for (size_t i = 0; i < taken; i++) {
+                intakeBatch[i].arrivalMinute = static_cast<uint32_t>(currentMinute);
+                dispatchPatient(intakeBatch[i], currentMinute);
             }
+            if (taken < INTAKE_BATCH) break;
+            budget -= taken;
+        }
+    }
 
-            allPatients.emplace_back(id, gender, arrivalTime, type);
+    // Hand one arriving patient to the next doctor
+    void dispatchPatient(const Patient& patient, int currentMinute) {
+        reporter.patientArrived(currentMinute, patient);
+        uint32_t handle = allocateSlot(patient, static_cast<uint32_t>(nextDoctor));
+        doctors[nextDoctor].queueFor(patient.type).push(handle, queueKey(patient.arrivalMinute, dispatchSequence++));
+        nextDoctor = (nextDoctor + 1) % doctors.size();
+        if (patient.type == PatientType::Urgent) {
+            totalUrgent++;
+            waitingUrgent++;
         }
+        else {
+            totalNormal++;
+        }
+        waitingPatients++;
     }
 
-    // Dispatch patients to their respective queues based on the current time
-    void dispatchPatients(const string& currentTime) {
-        auto it = allPatients.begin();
-        while (it != allPatients.end()) {
-            if (it->arrivalTime <= currentTime) {
-                if (it->type == "Urgent") {
-                    urgentQueue.push(*it);
-                    totalUrgent++;
-                }
-                else {
-                    normalQueue.push(*it);
-                    totalNormal++;
+    // Triage escalation: move a waiting normal patient into their doctor's urgent queue, or put an
+    // urgent patient at its front. False if no patient with that ID is waiting.
+    bool escalatePatient(uint64_t id) {
+        uint32_t handle = findWaiting(id);
+        if (handle == NO_POSITION) return false;
+        Patient& patient = waiting[handle];
+        Doctor<Policy>& doctor = doctors[slotDoctors[handle]];
+        if (patient.type == PatientType::Urgent) {
+            doctor.urgentQueue.updateKey(handle, queueKey(0, dispatchSequence++));
+        }
+        else {
+            doctor.normalQueue.erase(handle);
+            patient.type = PatientType::Urgent;
+            waitingUrgent++;
+            doctor.urgentQueue.push(handle, queueKey(patient.arrivalMinute, dispatchSequence++));
+        }
+        escalatedPatients++;
+        return true;
+    }
+
+    // A waiting patient left without being seen. False if no patient with that ID is waiting.
+    bool removePatient(uint64_t id) {
+        uint32_t handle = findWaiting(id);
+        if (handle == NO_POSITION) return false;
+        doctors[slotDoctors[handle]].queueFor(waiting[handle].type).erase(handle);
+        releaseSlot(handle);
+        walkedOutPatients++;
+        return true;
+    }
+
+    // Each doctor serves a random number of patients based on their priority at the given minute
+    void servePatients(int currentMinute) {
+        for (size_t d = 0; d < doctors.size() && waitingPatients > 0; d++) {
+            int maxToServe = drawServiceCapacity();
+            Patient patient;
+            for (int i = 0; i < maxToServe && takeNextPatient(d, patient); i++) {
+                servePatient(patient, currentMinute);
+            }
+        }
+        reporter.queueDepths(currentMinute, waitingUrgent, waitingPatients - waitingUrgent);
+    }
+
+    // Serve a single patient, recording how long they waited since arrival
+    void servePatient(Patient& patient, int currentMinute) {
+        uint32_t waited = currentMinute - patient.arrivalMinute;
+        patient.waitTime = static_cast<uint16_t>(min<uint32_t>(waited, UINT16_MAX));
+        (patient.type == PatientType::Urgent ? urgentWaits : normalWaits).record(waited);
+        totalWaitTime += waited;
+        servedPatients++;
+        if (keepDonePatients) donePatients.push_back(patient);
+        reporter.patientServed(currentMinute, patient, waited);
+    }
+
+    // Display what changed in the given minute and how many patients are still waiting
+    void displayStatus(int currentMinute) {
+        reporter.endMinute(currentMinute);
+    }
+
+    // Display the simulation summary
+    void displaySummary() {
+        reporter.finish();
+        OutputSink& out = reporter.output();
+        out << "\nSimulation Summary:\n";
+        out << "--------------------------------\n";
+        out << "Total Patients: " << (totalUrgent + totalNormal) << "\n";
+        out << "Urgent Patients: " << totalUrgent << "\n";
+        out << "Normal Patients: " << totalNormal << "\n";
+        out << "Served Patients: " << servedPatients << "\n";
+        if (escalatedPatients > 0 || walkedOutPatients > 0) {
+            out << "Escalated Patients: " << escalatedPatients << ", Walked Out: " << walkedOutPatients << "\n";
+        }
+        if (doctors.size() > 1) {
+            out << "Doctors: " << doctors.size() << ", Patients Stolen by Idle Doctors: " << stolenPatients << "\n";
+        }
+        out << "Average Waiting Time: " << (servedPatients > 0 ? totalWaitTime / servedPatients : 0) << " minutes.\n";
+        displayWaitPercentiles("Urgent", urgentWaits);
+        displayWaitPercentiles("Normal", normalWaits);
+        out.flush();
+    }
+
+    void displayWaitPercentiles(const char* label, const LatencyHistogram& waits) {
+        reporter.output() << label << " Wait (minutes): p50 " << waits.percentile(50) << ", p90 " << waits.percentile(90)
+            << ", p99 " << waits.percentile(99) << ", max " << waits.maximum() << "\n";
+    }
+};
+
+// Kinds of events processed by the headless simulation engine
+enum class EventType {
+    Arrival, // Pending patients reach their arrival time
+    Service  // Doctors serve the next batch of waiting patients
+};
+
+struct SimulationEvent {
+    int time;       // Minutes since the start of the simulation
+    EventType type;
+};
+
+// Orders events by time, processing arrivals before service within the same minute
+struct LaterEvent {
+    bool operator()(const SimulationEvent& a, const SimulationEvent& b) const {
+        if (a.time != b.time) return a.time > b.time;
+        return a.type > b.type;
+    }
+};
+
+// Non-interactive engine that jumps from one arrival or service event to the next
+template <typename System>
+class SimulationEngine {
+private:
+    System& system;
+    priority_queue<SimulationEvent, vector<SimulationEvent>, LaterEvent> events;
+    bool serviceScheduled = false;
+    long long processedEvents = 0;
+
+    void scheduleService(int time) {
+        events.push({ time, EventType::Service });
+        serviceScheduled = true;
+    }
+
+    void scheduleNextArrival() {
+        int minute = system.nextArrivalMinute();
+        if (minute >= 0) {
+            events.push({ minute, EventType::Arrival });
+        }
+    }
+
+public:
+    SimulationEngine(System& system) : system(system) {}
+
+    long long eventCount() const {
+        return processedEvents;
+    }
+
+    // Run the simulation for the given number of days from startMinute without waiting for input; with
+    // no day limit it runs until every arrival has been served. Patients already waiting, as in a
+    // restored checkpoint, are served from startMinute on.
+    void run(int days, int startMinute = 0) {
+        scheduleNextArrival();
+        if (!serviceScheduled && system.hasWaitingPatients()) {
+            scheduleService(startMinute);
+        }
+
+        int endMinute = days > 0 ? startMinute + days * MINUTES_PER_DAY : INT_MAX;
+        while (!events.empty()) {
+            SimulationEvent event = events.top();
+            if (event.time >= endMinute) break;
+            events.pop();
+            processedEvents++;
+
+            if (event.type == EventType::Arrival) {
+                system.dispatchPatients(event.time);
+                scheduleNextArrival();
+                if (!serviceScheduled && system.hasWaitingPatients()) {
+                    scheduleService(event.time);
                 }
-                it = allPatients.erase(it); // Remove patient from the vector
             }
             else {
-                ++it;
+                system.servePatients(event.time);
+                serviceScheduled = false;
+                if (system.hasWaitingPatients()) {
+                    scheduleService(event.time + 1);
+                }
             }
         }
     }
+};
 
-    // Serve patients based on their priority
-    void servePatients(int maxToServe) {
-        for (int i = 0; i < maxToServe; i++) {
-            if (!urgentQueue.empty()) {
-                Patient patient = urgentQueue.top();
-                urgentQueue.pop();
-                servePatient(patient);
-            }
-            else if (!normalQueue.empty()) {
-                Patient patient = normalQueue.front();
-                normalQueue.pop();
-                servePatient(patient);
-            }
-            else {
-                break;
+// Command line settings shared by every simulation mode
+struct SimulationOptions {
+    int numPatients = -1;
+    int days = 1;
+    int minServicePerTick = 5;
+    int maxServicePerTick = 10;
+    uint64_t seed = static_cast<uint64_t>(time(0));
+    bool seedGiven = false;
+    int sweepFrom = 0;        // Lowest minimum capacity in a sweep
+    int sweepTo = -1;         // Highest minimum capacity in a sweep
+    int replications = 1000;
+    unsigned threads = max(1u, thread::hardware_concurrency());
+    int doctors = 1;
+    PolicyKind policy = PolicyKind::StrictPriority;
+    bool policyGiven = false;
+    string tracePath;
+    string generatePath;
+    string checkpointPath;     // Save the final state of a headless run here
+    string resumePath;         // Continue a headless run from this checkpoint
+    ArrivalDistribution distribution = ArrivalDistribution::Uniform;
+    ReportMode reportMode = ReportMode::SummaryOnly;
+    bool reportGiven = false;  // Interactive runs report changes unless told otherwise
+    bool daysGiven = false;   // Traces replay to the end unless --days is given
+};
+
+// Parse a "FROM:TO" pair of integers
+bool parseRange(const string& text, int& from, int& to) {
+    size_t colon = text.find(':');
+    if (colon == string::npos) return false;
+    from = stoi(text.substr(0, colon));
+    to = stoi(text.substr(colon + 1));
+    return from >= 0 && to >= from;
+}
+
+bool parseDistribution(const string& text, ArrivalDistribution& distribution) {
+    if (text == "uniform") distribution = ArrivalDistribution::Uniform;
+    else if (text == "poisson") distribution = ArrivalDistribution::Poisson;
+    else if (text == "curve") distribution = ArrivalDistribution::TimeOfDay;
+    else return false;
+    return true;
+}
+
+// Parse a policy name as printed by the policies themselves
+bool parsePolicy(const string& text, PolicyKind& kind) {
+    if (text == StrictPriorityPolicy::name()) kind = PolicyKind::StrictPriority;
+    else if (text == AgingPolicy::name()) kind = PolicyKind::Aging;
+    else if (text == WeightedFairPolicy::name()) kind = PolicyKind::WeightedFair;
+    else if (text == EarliestDeadlinePolicy::name()) kind = PolicyKind::EarliestDeadline;
+    else return false;
+    return true;
+}
+
+// Take the policy, patients per day and seed of the run a checkpoint continues; any of them given on the
+// command line again must match
+bool resumeSettings(SimulationOptions& options) {
+    CheckpointReader in;
+    string policyName;
+    RunSettings settings;
+    PolicyKind policy;
+    if (!in.open(options.resumePath) || !in.text(policyName) || !settings.load(in) || !parsePolicy(policyName, policy)) {
+        cerr << "Checkpoint error: " << options.resumePath << " is missing or is not a checkpoint\n";
+        return false;
+    }
+    string conflict;
+    if (options.policyGiven && options.policy != policy) conflict = "--policy";
+    else if (options.numPatients >= 0 && options.numPatients != settings.patientsPerDay) conflict = "--patients";
+    else if (options.seedGiven && options.seed != settings.seed) conflict = "--seed";
+    if (!conflict.empty()) {
+        cerr << "Checkpoint error: " << conflict << " differs from the run saved in " << options.resumePath << "\n";
+        return false;
+    }
+    options.policy = policy;
+    options.numPatients = settings.patientsPerDay;
+    options.seed = settings.seed;
+    return true;
+}
+
+// Run a full simulation without prompting, printing only the summary. With --resume the run continues
+// from a checkpoint for another --days days; with --checkpoint the final state is saved.
+template <typename Policy>
+int runHeadless(const SimulationOptions& options) {
+    PatientSchedulingSystem<Policy> system(options.seed);
+    system.setArrivalDistribution(options.distribution);
+    system.setReportMode(options.reportMode);
+    system.setDoctorCount(options.doctors);
+    system.setServiceCapacity(options.minServicePerTick, options.maxServicePerTick);
+
+    int startMinute = 0;
+    if (!options.resumePath.empty()) {
+        auto restoreStart = chrono::steady_clock::now();
+        string error;
+        if (!system.restoreCheckpoint(options.resumePath, startMinute, error)) {
+            cerr << "Checkpoint error: " << error << "\n";
+            return 1;
+        }
+        auto restoreMs = chrono::duration<double, milli>(chrono::steady_clock::now() - restoreStart).count();
+        cout << "Restored " << options.resumePath << " at " << formatTime(startMinute) << " in " << restoreMs << " ms ("
+            << options.numPatients << " patients a day, seed " << options.seed << ").\n";
+    }
+    int firstDay = startMinute / MINUTES_PER_DAY;
+    for (int day = firstDay; day < firstDay + options.days; day++) {
+        system.populatePatients(options.numPatients, day);
+    }
+
+    auto start = chrono::steady_clock::now();
+    SimulationEngine engine(system);
+    engine.run(options.days, startMinute);
+    auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    system.displaySummary();
+    cout << "Simulated " << options.days << " day(s), " << engine.eventCount() << " events in "
+        << elapsed << " ms (" << Policy::name() << " policy, seed " << options.seed << ").\n";
+
+    if (!options.checkpointPath.empty()) {
+        auto saveStart = chrono::steady_clock::now();
+        if (!system.saveCheckpoint(options.checkpointPath, startMinute + options.days * MINUTES_PER_DAY,
+                { options.numPatients, options.seed })) {
+            cerr << "Cannot write " << options.checkpointPath << "\n";
+            return 1;
+        }
+        auto saveMs = chrono::duration<double, milli>(chrono::steady_clock::now() - saveStart).count();
+        cout << "Saved checkpoint " << options.checkpointPath << " in " << saveMs << " ms.\n";
+    }
+    return 0;
+}
+
+// Runs tasks on a fixed set of threads. Each thread works through its own deque from the back
+// and, once that runs dry, steals from the front of another thread's deque.
+class WorkStealingPool {
+private:
+    struct Worker {
+        mutex lock;
+        deque<size_t> tasks;
+    };
+
+    static bool popLocal(Worker& worker, size_t& task) {
+        lock_guard<mutex> guard(worker.lock);
+        if (worker.tasks.empty()) return false;
+        task = worker.tasks.back();
+        worker.tasks.pop_back();
+        return true;
+    }
+
+    static bool steal(Worker& victim, size_t& task) {
+        lock_guard<mutex> guard(victim.lock);
+        if (victim.tasks.empty()) return false;
+        task = victim.tasks.front();
+        victim.tasks.pop_front();
+        return true;
+    }
+
+public:
+    static void run(size_t taskCount, unsigned threadCount, const function<void(unsigned, size_t)>& runTask) {
+        vector<Worker> workers(threadCount);
+        for (size_t task = 0; task < taskCount; task++) {
+            workers[task % threadCount].tasks.push_back(task);
+        }
+
+        auto work = [&](unsigned self) {
+            size_t task;
+            while (true) {
+                bool found = popLocal(workers[self], task);
+                for (unsigned i = 1; !found && i < threadCount; i++) {
+                    found = steal(workers[(self + i) % threadCount], task);
+                }
+                if (!found) return; // Tasks are never added once running, so every deque is drained
+                runTask(self, task);
             }
+        };
+
+        vector<thread> threads;
+        for (unsigned i = 1; i < threadCount; i++) {
+            threads.emplace_back(work, i);
+        }
+        work(0);
+        for (auto& t : threads) {
+            t.join();
         }
     }
+};
 
-    // Serve a single patient
-    void servePatient(Patient& patient) {
-        totalWaitTime += patient.waitTime;
-        donePatients.push_back(patient);
-        cout << "Serving Patient ID: " << patient.id << ", Type: " << patient.type
-            << ", Wait Time: " << patient.waitTime << " minutes.\n";
+// Totals of every replication run at one service capacity
+struct SweepResult {
+    LatencyHistogram urgentWaits;
+    LatencyHistogram normalWaits;
+    uint64_t patients = 0;
+    uint64_t served = 0;
+
+    void merge(const SweepResult& other) {
+        urgentWaits.merge(other.urgentWaits);
+        normalWaits.merge(other.normalWaits);
+        patients += other.patients;
+        served += other.served;
     }
+};
+
+// Run independent replications for each service capacity across all threads and merge their waits
+template <typename Policy>
+int runSweep(const SimulationOptions& options) {
+    int spread = options.maxServicePerTick - options.minServicePerTick;
+    size_t capacities = options.sweepTo - options.sweepFrom + 1;
+    size_t taskCount = capacities * options.replications;
+    unsigned threadCount = static_cast<unsigned>(min<size_t>(options.threads, taskCount));
+    vector<vector<SweepResult>> perThread(threadCount, vector<SweepResult>(capacities));
+
+    auto start = chrono::steady_clock::now();
+    WorkStealingPool::run(taskCount, threadCount, [&](unsigned self, size_t task) {
+        size_t capacityIndex = task / options.replications;
+        int minPerTick = options.sweepFrom + static_cast<int>(capacityIndex);
+        uint64_t seedState = options.seed + task;
 
-    // Display the current status of the system
-    void displayStatus() {
-        cout << "\nWaiting Urgent Patients:\n";
-        priority_queue<Patient, vector<Patient>, UrgentPatientComparator> tempUrgentQueue = urgentQueue;
-        while (!tempUrgentQueue.empty()) {
-            cout << tempUrgentQueue.top().id << " ";
-            tempUrgentQueue.pop();
+        PatientSchedulingSystem<Policy> system(splitMix64(seedState));
+        system.setArrivalDistribution(options.distribution);
+        system.setReportMode(ReportMode::SummaryOnly);
+        system.setDoctorCount(options.doctors);
+        system.setServiceCapacity(minPerTick, minPerTick + spread);
+        for (int day = 0; day < options.days; day++) {
+            system.populatePatients(options.numPatients, day);
         }
+        SimulationEngine engine(system);
+        engine.run(options.days);
 
-        cout << "\n\nWaiting Normal Patients:\n";
-        queue<Patient> tempNormalQueue = normalQueue;
-        while (!tempNormalQueue.empty()) {
-            cout << tempNormalQueue.front().id << " ";
-            tempNormalQueue.pop();
+        SweepResult& result = perThread[self][capacityIndex];
+        result.urgentWaits.merge(system.waitHistogram(PatientType::Urgent));
+        result.normalWaits.merge(system.waitHistogram(PatientType::Normal));
+        result.patients += system.dispatchedCount(); // Poisson and curve arrivals vary around numPatients
+        result.served += system.servedCount();
+    });
+    auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Capacity sweep: " << options.replications << " replications of " << options.numPatients
+        << " patients/day for " << options.days << " day(s), " << options.doctors << " doctor(s), "
+        << Policy::name() << " policy, seed " << options.seed << "\n";
+    cout << setw(10) << "Capacity" << setw(10) << "Served%" << setw(10) << "Urg p50" << setw(10) << "Urg p99"
+        << setw(10) << "Urg max" << setw(10) << "Nrm p50" << setw(10) << "Nrm p90" << setw(10) << "Nrm p99"
+        << setw(10) << "Nrm max" << "\n";
+    for (size_t c = 0; c < capacities; c++) {
+        SweepResult total;
+        for (const auto& results : perThread) {
+            total.merge(results[c]);
         }
+        int minPerTick = options.sweepFrom + static_cast<int>(c);
+        string label = to_string(minPerTick) + "-" + to_string(minPerTick + spread);
+        cout << setw(10) << label << setw(10) << fixed << setprecision(1)
+            << (total.patients > 0 ? 100.0 * total.served / total.patients : 0)
+            << setw(10) << total.urgentWaits.percentile(50) << setw(10) << total.urgentWaits.percentile(99)
+            << setw(10) << total.urgentWaits.maximum() << setw(10) << total.normalWaits.percentile(50)
+            << setw(10) << total.normalWaits.percentile(90) << setw(10) << total.normalWaits.percentile(99)
+            << setw(10) << total.normalWaits.maximum() << "\n";
+    }
+    cout << taskCount << " replications on " << threadCount << " thread(s) in " << setprecision(2)
+        << elapsed << " s.\n";
+    return 0;
+}
 
-        cout << "\n\nDone Patients:\n";
-        for (const auto& patient : donePatients) {
-            cout << patient.id << " ";
+// Bounded single-producer, multi-consumer FIFO of patient indices. Only the owning thread pushes at the
+// back; every thread, the owner included, takes from the front with one compare-and-swap, so each doctor
+// still sees their patients in arrival order. Slots are never reused, so the capacity must cover every
+// push ever made.
+class StealableQueue {
+private:
+    vector<atomic<uint32_t>> slots;
+    size_t mask;
+    alignas(64) atomic<int64_t> top{ 0 };
+    alignas(64) atomic<int64_t> bottom{ 0 };
+
+public:
+    explicit StealableQueue(size_t capacity) : slots(size_t(1) << (highestBit(max<size_t>(capacity, 1)) + 1)) {
+        mask = slots.size() - 1;
+    }
+
+    void push(uint32_t value) {
+        int64_t b = bottom.load(memory_order_relaxed);
+        slots[b & mask].store(value, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        bottom.store(b + 1, memory_order_relaxed);
+    }
+
+    // Take the oldest value; false once the queue is empty
+    bool steal(uint32_t& value) {
+        while (true) {
+            int64_t t = top.load(memory_order_acquire);
+            atomic_thread_fence(memory_order_seq_cst);
+            int64_t b = bottom.load(memory_order_acquire);
+            if (t >= b) return false;
+            uint32_t candidate = slots[t & mask].load(memory_order_relaxed);
+            if (top.compare_exchange_weak(t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+                value = candidate;
+                return true;
+            }
         }
-        cout << "\n";
     }
+};
 
-    // Display the simulation summary
-    void displaySummary() {
-        cout << "\nSimulation Summary:\n";
-        cout << "--------------------------------\n";
-        cout << "Total Patients: " << (totalUrgent + totalNormal) << "\n";
-        cout << "Urgent Patients: " << totalUrgent << "\n";
-        cout << "Normal Patients: " << totalNormal << "\n";
-        cout << "Average Waiting Time: " << (donePatients.size() > 0 ? totalWaitTime / donePatients.size() : 0) << " minutes.\n";
+// Reusable barrier that lines the doctor threads up between phases of a minute
+class TickBarrier {
+private:
+    mutex lock;
+    condition_variable released;
+    unsigned threadCount;
+    unsigned arrived = 0;
+    uint64_t generation = 0;
+
+public:
+    explicit TickBarrier(unsigned threadCount) : threadCount(threadCount) {}
+
+    void arriveAndWait() {
+        unique_lock<mutex> guard(lock);
+        uint64_t current = generation;
+        if (++arrived == threadCount) {
+            arrived = 0;
+            generation++;
+            released.notify_all();
+            return;
+        }
+        released.wait(guard, [&] { return generation != current; });
     }
 };
 
-int main() {
-    srand(static_cast<unsigned int>(time(0))); // Seed for random number generation
+// Replay an arrival trace, streaming it from disk as simulated time advances
+template <typename Policy>
+int runTrace(const SimulationOptions& options) {
+    TraceReader reader;
+    if (!reader.open(options.tracePath)) {
+        cerr << "Trace error: " << reader.error() << "\n";
+        return 1;
+    }
+
+    PatientSchedulingSystem<Policy> system(options.seed);
+    system.setReportMode(options.reportMode);
+    system.setKeepDonePatients(false);
+    system.setDoctorCount(options.doctors);
+    system.setServiceCapacity(options.minServicePerTick, options.maxServicePerTick);
+    system.attachTrace(reader);
+
+    auto start = chrono::steady_clock::now();
+    SimulationEngine engine(system);
+    engine.run(options.daysGiven ? options.days : 0);
+    auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    system.displaySummary();
+    cout << "Replayed " << reader.count() << " arrivals from " << options.tracePath << ", "
+        << engine.eventCount() << " events in " << elapsed << " ms (" << Policy::name() << " policy).\n";
+    if (!reader.error().empty()) {
+        cerr << "Trace error: " << reader.error() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+// Write a synthetic trace straight to disk without holding the patients in memory
+int runGenerate(const SimulationOptions& options) {
+    TraceWriter writer;
+    if (!writer.open(options.generatePath)) {
+        cerr << "Cannot write " << options.generatePath << "\n";
+        return 1;
+    }
+    WorkloadGenerator generator(options.seed, options.distribution);
+
+    auto start = chrono::steady_clock::now();
+    for (int day = 0; day < options.days; day++) {
+        generator.generateDay(options.numPatients, day, [&](const Patient& patient) { writer.write(patient); });
+    }
+    if (!writer.close()) {
+        cerr << "Failed writing " << options.generatePath << "\n";
+        return 1;
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Wrote " << writer.count() << " patients to " << options.generatePath << " in " << fixed
+        << setprecision(3) << elapsed << " s (" << setprecision(0) << writer.count() / max(elapsed, 1e-9)
+        << " patients/s).\n";
+    return 0;
+}
+
+// Generate the random arrivals of a run once, so several runs can replay the same trace
+vector<Patient> generateTrace(const SimulationOptions& options) {
+    PatientSchedulingSystem<> generator(options.seed);
+    generator.setArrivalDistribution(options.distribution);
+    for (int day = 0; day < options.days; day++) {
+        generator.populatePatients(options.numPatients, day);
+    }
+    return generator.takePendingPatients();
+}
+
+// Replay a trace under one policy and print its throughput and tail latency
+template <typename Policy>
+void comparePolicy(const vector<Patient>& trace, const SimulationOptions& options) {
+    PatientSchedulingSystem<Policy> system(options.seed);
+    system.setReportMode(ReportMode::SummaryOnly);
+    system.setDoctorCount(options.doctors);
+    system.setServiceCapacity(options.minServicePerTick, options.maxServicePerTick);
+    system.addPatients(trace);
+
+    auto start = chrono::steady_clock::now();
+    SimulationEngine engine(system);
+    engine.run(options.days);
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    const LatencyHistogram& urgent = system.waitHistogram(PatientType::Urgent);
+    const LatencyHistogram& normal = system.waitHistogram(PatientType::Normal);
+    cout << setw(8) << Policy::name() << setw(12) << fixed << setprecision(2) << elapsed * 1000
+        << setw(14) << setprecision(0) << system.servedCount() / max(elapsed, 1e-9) << setw(10) << system.servedCount()
+        << setw(10) << urgent.percentile(50) << setw(10) << urgent.percentile(99) << setw(10) << urgent.maximum()
+        << setw(10) << normal.percentile(50) << setw(10) << normal.percentile(99) << setw(10) << normal.maximum() << "\n";
+}
+
+// Run every policy on the same arrival trace and capacity draws
+int runPolicyComparison(const SimulationOptions& options) {
+    vector<Patient> trace = generateTrace(options);
+    cout << "Policy comparison: " << trace.size() << " patients over " << options.days << " day(s), "
+        << options.doctors << " doctor(s), seed " << options.seed << "\n";
+    cout << setw(8) << "Policy" << setw(12) << "Time (ms)" << setw(14) << "Patients/s" << setw(10) << "Served"
+        << setw(10) << "Urg p50" << setw(10) << "Urg p99" << setw(10) << "Urg max" << setw(10) << "Nrm p50"
+        << setw(10) << "Nrm p99" << setw(10) << "Nrm max" << "\n";
+    comparePolicy<StrictPriorityPolicy>(trace, options);
+    comparePolicy<AgingPolicy>(trace, options);
+    comparePolicy<WeightedFairPolicy>(trace, options);
+    comparePolicy<EarliestDeadlinePolicy>(trace, options);
+    return 0;
+}
+
+// Measure multi-core dispatch throughput with one real thread per doctor. This is a separate, simplified
+// model rather than PatientSchedulingSystem, whose queues are single-threaded: urgent patients always go
+// first whatever the policy, a doctor steals from the next colleague with work rather than the busiest,
+// and patients never escalate or walk out. Each minute every doctor pushes their share of the arrivals
+// into lock-free queues, then serves their own queue and steals from colleagues.
+int runThreadedDispatch(const SimulationOptions& options) {
+    const vector<Patient> patients = generateTrace(options);
+
+    unsigned doctorCount = static_cast<unsigned>(options.doctors);
+    size_t perDoctor = patients.size() / doctorCount + 1;
+    vector<unique_ptr<StealableQueue>> urgentQueues;
+    vector<unique_ptr<StealableQueue>> normalQueues;
+    for (unsigned d = 0; d < doctorCount; d++) {
+        urgentQueues.push_back(make_unique<StealableQueue>(perDoctor));
+        normalQueues.push_back(make_unique<StealableQueue>(perDoctor));
+    }
+    vector<SweepResult> results(doctorCount);
+    vector<uint64_t> stolen(doctorCount, 0);
+    TickBarrier barrier(doctorCount);
+    int endMinute = options.days * MINUTES_PER_DAY;
+
+    auto takeFrom = [&](vector<unique_ptr<StealableQueue>>& queues, unsigned self, uint32_t& index) {
+        if (queues[self]->steal(index)) return true;
+        for (unsigned i = 1; i < doctorCount; i++) {
+            if (queues[(self + i) % doctorCount]->steal(index)) {
+                stolen[self]++;
+                return true;
+            }
+        }
+        return false;
+    };
+
+    auto doctorThread = [&](unsigned self) {
+        Xoshiro256 rng(options.seed + self + 1);
+        size_t next = self; // Doctors own every doctorCount-th arrival, matching round-robin dispatch
+        SweepResult& result = results[self];
+        for (int minute = 0; minute < endMinute; minute++) {
+            for (; next < patients.size() && static_cast<int>(patients[next].arrivalMinute) <= minute; next += doctorCount) {
+                const Patient& patient = patients[next];
+                (patient.type == PatientType::Urgent ? urgentQueues : normalQueues)[self]->push(static_cast<uint32_t>(next));
+                result.patients++;
+            }
+            barrier.arriveAndWait();
+
+            int maxToServe = options.minServicePerTick
+                + static_cast<int>(rng.below(options.maxServicePerTick - options.minServicePerTick + 1));
+            uint32_t index;
+            for (int i = 0; i < maxToServe; i++) {
+                if (!takeFrom(urgentQueues, self, index) && !takeFrom(normalQueues, self, index)) break;
+                const Patient& patient = patients[index];
+                (patient.type == PatientType::Urgent ? result.urgentWaits : result.normalWaits)
+                    .record(minute - patient.arrivalMinute);
+                result.served++;
+            }
+            barrier.arriveAndWait();
+        }
+    };
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (unsigned d = 1; d < doctorCount; d++) {
+        threads.emplace_back(doctorThread, d);
+    }
+    doctorThread(0);
+    for (auto& t : threads) {
+        t.join();
+    }
+    auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    SweepResult total;
+    uint64_t totalStolen = 0;
+    for (unsigned d = 0; d < doctorCount; d++) {
+        total.merge(results[d]);
+        totalStolen += stolen[d];
+    }
+    cout << "Threaded dispatch: " << doctorCount << " doctor thread(s), " << total.patients << " patients over "
+        << options.days << " day(s)\n";
+    cout << "Served " << total.served << " (" << totalStolen << " stolen) in " << fixed << setprecision(3)
+        << elapsed << " s, " << setprecision(0) << total.served / elapsed << " patients/s\n";
+    cout << "Urgent wait p99 " << total.urgentWaits.percentile(99) << ", Normal wait p99 "
+        << total.normalWaits.percentile(99) << " minutes.\n";
+    return 0;
+}
+
+// Time populate and a full simulated day for patient counts from 1e3 to 1e7
+int runScaling(const SimulationOptions& options) {
+    cout << setw(10) << "Patients" << setw(16) << "Populate (ms)" << setw(16) << "Simulate (ms)"
+        << setw(16) << "ns/patient" << "\n";
+    for (int count = 1000; count <= 10000000; count *= 10) {
+        PatientSchedulingSystem<> system(options.seed);
+        system.setReportMode(ReportMode::SummaryOnly);
+
+        auto start = chrono::steady_clock::now();
+        system.populatePatients(count);
+        auto populated = chrono::steady_clock::now();
+        SimulationEngine engine(system);
+        engine.run(1);
+        auto finished = chrono::steady_clock::now();
+
+        double populateMs = chrono::duration<double, milli>(populated - start).count();
+        double simulateMs = chrono::duration<double, milli>(finished - populated).count();
+        cout << setw(10) << count << setw(16) << fixed << setprecision(1) << populateMs
+            << setw(16) << simulateMs << setw(16) << simulateMs * 1e6 / count << "\n";
+    }
+    return 0;
+}
+
+// Stress the live intake: desk threads submit pre-generated patients while the scheduler ticks, draining the
+// ring, dispatching and serving. Reports intake throughput as the number of desks doubles.
+int runIntakeBenchmark(const SimulationOptions& options) {
+    const size_t RING_CAPACITY = 1 << 16;
+    int total = options.numPatients;
+    unsigned maxProducers = max(options.threads, 4u);
+    cout << setw(10) << "Desks" << setw(12) << "Patients" << setw(12) << "Time (ms)" << setw(16) << "Patients/s"
+        << setw(14) << "Full retries" << setw(8) << "Ticks" << "\n";
+    for (unsigned producers = 1; producers <= maxProducers; producers *= 2) {
+        vector<vector<Patient>> desks(producers);
+        WorkloadGenerator workload(options.seed, options.distribution);
+        for (unsigned d = 0; d < producers; d++) {
+            int share = total / producers + (d < total % producers ? 1 : 0);
+            desks[d].reserve(share);
+            workload.generateDay(share, 0, [&](const Patient& patient) { desks[d].push_back(patient); });
+        }
+
+        PatientSchedulingSystem<> system(options.seed);
+        system.setReportMode(ReportMode::SummaryOnly);
+        system.setKeepDonePatients(false);
+        system.setDoctorCount(options.doctors);
+        system.setServiceCapacity(options.minServicePerTick, options.maxServicePerTick);
+        system.openIntake(RING_CAPACITY);
+
+        atomic<uint64_t> retries{ 0 };
+        atomic<bool> go{ false };
+        vector<thread> threads;
+        for (unsigned d = 0; d < producers; d++) {
+            threads.emplace_back([&, d] {
+                while (!go.load(memory_order_acquire)) this_thread::yield();
+                uint64_t fullRetries = 0;
+                for (const Patient& patient : desks[d]) {
+                    while (!system.submitPatient(patient)) {
+                        fullRetries++;
+                        this_thread::yield();
+                    }
+                }
+                retries.fetch_add(fullRetries, memory_order_relaxed);
+            });
+        }
+
+        auto start = chrono::steady_clock::now();
+        go.store(true, memory_order_release);
+        int minute = 0;
+        while (system.dispatchedCount() < total) {
+            system.dispatchPatients(minute);
+            system.servePatients(minute);
+            minute++;
+            if (system.dispatchedCount() < total) this_thread::yield();
+        }
+        double elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        for (auto& desk : threads) desk.join();
+
+        cout << setw(10) << producers << setw(12) << total << setw(12) << fixed << setprecision(1) << elapsedMs
+            << setw(16) << setprecision(0) << total / max(elapsedMs / 1000, 1e-9) << setw(14) << retries.load()
+            << setw(8) << minute << "\n";
+    }
+    return 0;
+}
 
-    PatientSchedulingSystem system;
+// Advance the simulation one minute per Enter press, printing the status after every minute
+template <typename Policy>
+int runInteractive(const SimulationOptions& options) {
+    PatientSchedulingSystem<Policy> system(options.seed);
+    system.setArrivalDistribution(options.distribution);
+    system.setReportMode(options.reportGiven ? options.reportMode : ReportMode::Changes);
+    system.setDoctorCount(options.doctors);
+    system.setServiceCapacity(options.minServicePerTick, options.maxServicePerTick);
 
-    cout << "Enter the number of patients to simulate (e.g., 100, 300, 700): ";
-    int numPatients;
-    cin >> numPatients;
-    cin.ignore(); // Clear the newline character from the input buffer
+    int numPatients = options.numPatients;
+    if (numPatients < 0) {
+        cout << "Enter the number of patients to simulate (e.g., 100, 300, 700): ";
+        cin >> numPatients;
+        cin.ignore(); // Clear the newline character from the input buffer
+    }
 
     system.populatePatients(numPatients);
 
     cout << "\nPatient Scheduling System Simulation\n";
     cout << "-------------------------------------\n";
 
-    string currentTime = "00:00"; // Start simulation at midnight
+    int currentTime = 0; // Start simulation at midnight
     while (true) {
-        cout << "\nCurrent Time: " << currentTime << "\n";
-        cout << "Press Enter to advance 1 minute or type 'exit' to stop: ";
+        cout << "\nCurrent Time: " << formatTime(currentTime) << "\n";
+        cout << "Press Enter to advance 1 minute, type 'escalate ID' or 'leave ID' to update a waiting patient, or 'exit' to stop: ";
         string input;
         getline(cin, input);
 
         if (input == "exit") break;
 
+        istringstream command(input);
+        string action;
+        uint64_t id;
+        if (command >> action >> id && (action == "escalate" || action == "leave")) {
+            bool found = action == "escalate" ? system.escalatePatient(id) : system.removePatient(id);
+            cout << (found ? "Updated patient " : "No waiting patient with ID ") << setw(14) << setfill('0') << id
+                << setfill(' ') << ".\n";
+            continue;
+        }
+
         system.dispatchPatients(currentTime);
 
-        // Randomly serve 5 to 10 patients
-        system.servePatients(rand() % 6 + 5);
+        // Randomly serve 5 to 10 patients per doctor with the default capacity
+        system.servePatients(currentTime);
 
-        system.displayStatus();
+        system.displayStatus(currentTime);
 
         // Increment time by 1 minute
-        int hours = stoi(currentTime.substr(0, 2));
-        int minutes = stoi(currentTime.substr(3, 2)) + 1;
-        if (minutes == 60) {
-            minutes = 0;
-            hours++;
-        }
-        if (hours == 24) {
+        currentTime++;
+        if (currentTime == MINUTES_PER_DAY) {
             cout << "\nSimulation completed for a full day.\n";
             break;
         }
-
-        ostringstream oss;
-        oss << setw(2) << setfill('0') << hours << ":" << setw(2) << setfill('0') << minutes;
-        currentTime = oss.str();
     }
 
     system.displaySummary();
 
     return 0;
 }
+
+// The benchmark executable includes this file for the scheduler and brings its own main
+#ifndef SCHEDULING_NO_MAIN
+int main(int argc, char* argv[]) {
+    SimulationOptions options;
+    bool headless = false;
+    bool scaling = false;
+    bool threaded = false;
+    bool comparePolicies = false;
+    bool intakeBenchmark = false;
+    bool usageError = false;
+    for (int i = 1; i < argc && !usageError; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--headless") {
+            headless = true;
+        }
+        else if (arg == "--scaling") {
+            scaling = true;
+        }
+        else if (arg == "--patients" && hasValue) {
+            options.numPatients = stoi(argv[++i]);
+        }
+        else if (arg == "--days" && hasValue) {
+            options.days = max(1, stoi(argv[++i]));
+            options.daysGiven = true;
+        }
+        else if (arg == "--generate" && hasValue) {
+            options.generatePath = argv[++i];
+        }
+        else if (arg == "--distribution" && hasValue) {
+            usageError = !parseDistribution(argv[++i], options.distribution);
+        }
+        else if (arg == "--report" && hasValue) {
+            string mode = argv[++i];
+            options.reportMode = mode == "changes" ? ReportMode::Changes : ReportMode::SummaryOnly;
+            options.reportGiven = true;
+            usageError = mode != "changes" && mode != "summary";
+        }
+        else if (arg == "--quiet") {
+            options.reportMode = ReportMode::SummaryOnly;
+            options.reportGiven = true;
+        }
+        else if (arg == "--checkpoint" && hasValue) {
+            options.checkpointPath = argv[++i];
+        }
+        else if (arg == "--resume" && hasValue) {
+            options.resumePath = argv[++i];
+            headless = true;
+        }
+        else if (arg == "--trace" && hasValue) {
+            options.tracePath = argv[++i];
+        }
+        else if (arg == "--seed" && hasValue) {
+            options.seed = stoull(argv[++i]);
+            options.seedGiven = true;
+        }
+        else if (arg == "--capacity" && hasValue) {
+            usageError = !parseRange(argv[++i], options.minServicePerTick, options.maxServicePerTick);
+        }
+        else if (arg == "--sweep" && hasValue) {
+            usageError = !parseRange(argv[++i], options.sweepFrom, options.sweepTo);
+        }
+        else if (arg == "--replications" && hasValue) {
+            options.replications = max(1, stoi(argv[++i]));
+        }
+        else if (arg == "--doctors" && hasValue) {
+            options.doctors = max(1, stoi(argv[++i]));
+        }
+        else if (arg == "--policy" && hasValue) {
+            usageError = !parsePolicy(argv[++i], options.policy);
+            options.policyGiven = true;
+        }
+        else if (arg == "--compare-policies") {
+            comparePolicies = true;
+        }
+        else if (arg == "--intake-bench") {
+            intakeBenchmark = true;
+        }
+        else if (arg == "--threaded") {
+            threaded = true;
+        }
+        else if (arg == "--threads" && hasValue) {
+            options.threads = max(1, stoi(argv[++i]));
+        }
+        else {
+            usageError = true;
+        }
+    }
+    if (usageError) {
+        cerr << "Usage: " << argv[0] << " [--headless] [--patients N] [--days N] [--seed N] [--capacity MIN:MAX] [--doctors N]\n"
+            << "           [--policy strict|aging|fair|edf] [--report changes|summary] [--quiet]\n"
+            << "           [--checkpoint FILE] [--resume FILE]\n"
+            << "       " << argv[0] << " --generate FILE [--patients N] [--days N] [--distribution uniform|poisson|curve]\n"
+            << "       " << argv[0] << " --trace FILE [--days N] [--doctors N] [--policy NAME]\n"
+            << "       " << argv[0] << " --compare-policies [--patients N] [--days N] [--doctors N]\n"
+            << "       " << argv[0] << " --sweep FROM:TO [--replications N] [--threads N] [--patients N] [--days N]\n"
+            << "       " << argv[0] << " --threaded --doctors N [--patients N] [--days N]\n"
+            << "       " << argv[0] << " --intake-bench [--threads N] [--patients N] [--doctors N]\n"
+            << "       " << argv[0] << " --scaling\n";
+        return 1;
+    }
+
+    if (scaling) {
+        return runScaling(options);
+    }
+    if (intakeBenchmark) {
+        if (options.numPatients < 0) options.numPatients = 2000000;
+        return runIntakeBenchmark(options);
+    }
+    if (comparePolicies) {
+        if (options.numPatients < 0) options.numPatients = 700;
+        return runPolicyComparison(options);
+    }
+    if (options.sweepTo >= options.sweepFrom) {
+        if (options.numPatients < 0) options.numPatients = 700;
+        return withPolicy(options.policy, [&](auto policy) { return runSweep<decltype(policy)>(options); });
+    }
+    if (!options.generatePath.empty()) {
+        if (options.numPatients < 0) options.numPatients = 700;
+        return runGenerate(options);
+    }
+    if (!options.tracePath.empty()) {
+        return withPolicy(options.policy, [&](auto policy) { return runTrace<decltype(policy)>(options); });
+    }
+    if (threaded) {
+        if (options.numPatients < 0) options.numPatients = 700;
+        return runThreadedDispatch(options);
+    }
+    if (headless) {
+        if (!options.resumePath.empty() && !resumeSettings(options)) return 1;
+        if (options.numPatients < 0) options.numPatients = 700;
+        return withPolicy(options.policy, [&](auto policy) { return runHeadless<decltype(policy)>(options); });
+    }
+
+    return withPolicy(options.policy, [&](auto policy) { return runInteractive<decltype(policy)>(options); });
+}
+#endif
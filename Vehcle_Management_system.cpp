@@ -1,251 +1,2580 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include <map>
 #include <string>
 #include <sstream>
 #include <limits>
+#include <unordered_map>
+#include <map>
+#include <set>
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <algorithm>
+#include <deque>
+#include <ctime>
+#include <cctype>
+#include <cmath>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <condition_variable>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <signal.h>
+#include <cerrno>
+#include <random>
+#endif
 using namespace std;
 
-// Forward declarations
-class Admin;
-class Renter;
+// Forward declarations
+class Admin;
+class Renter;
+
+// Ensure a file exists or create it if missing
+void ensureFileExists(const string& filename) {
+    ifstream file(filename);
+    if (!file) { // File does not exist
+        ofstream newFile(filename);
+        if (newFile) {
+            cout << "Created file: " << filename << endl;
+        }
+        else {
+            cerr << "Failed to create file: " << filename << endl;
+        }
+    }
+}
+
+// Replace a file with another one; rename does not overwrite an existing file on Windows
+bool replaceFile(const string& from, const string& to) {
+#ifdef _WIN32
+    remove(to.c_str());
+#endif
+    return rename(from.c_str(), to.c_str()) == 0;
+}
+
+bool fileExists(const string& filename) {
+    return static_cast<bool>(ifstream(filename));
+}
+
+// How long a change waits for its journal record
+enum class Durability {
+    Buffered, // Not at all; the record is committed with the next batch, within the commit interval
+    Synced,   // Until the record is on disk
+};
+
+// Append-only log of changes made since the last snapshot, committed in groups. Appending only queues
+// the record; a writer thread writes and syncs everything queued in one write and one fsync, once the
+// oldest queued record is COMMIT_INTERVAL old, COMMIT_BATCH records are waiting, or a Synced append or
+// sync() asks for it. A crash can lose Buffered records from at most the last interval.
+class Journal {
+    static constexpr chrono::milliseconds COMMIT_INTERVAL{ 10 };
+    static const size_t COMMIT_BATCH = 256;
+
+    int fd = -1;
+    size_t records = 0;
+
+    mutable mutex lock;
+    condition_variable queued;    // Wakes the writer
+    condition_variable committed; // Wakes whoever waits for a record
+    string pending;
+    size_t pendingRecords = 0;
+    chrono::steady_clock::time_point oldestPending;
+    uint64_t lastQueued = 0;    // Sequence number of the last record queued
+    uint64_t lastCommitted = 0; // Of the last record on disk, or dropped by clear()
+    bool commitNow = false;
+    bool writing = false;
+    bool stopping = false;
+    bool failed = false;
+    thread writer;
+
+    bool writeAndSync(const string& batch) {
+        size_t written = 0;
+        while (written < batch.size()) {
+#ifdef _WIN32
+            int count = _write(fd, batch.data() + written, static_cast<unsigned>(batch.size() - written));
+#else
+            ssize_t count = ::write(fd, batch.data() + written, batch.size() - written);
+            if (count < 0 && errno == EINTR) continue;
+#endif
+            if (count <= 0) return false;
+            written += static_cast<size_t>(count);
+        }
+#ifdef _WIN32
+        return _commit(fd) == 0;
+#else
+        return fsync(fd) == 0;
+#endif
+    }
+
+    void writeBatches() {
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            queued.wait(guard, [this] { return stopping || pendingRecords > 0; });
+            if (pendingRecords == 0) break; // Stopping with nothing left
+            queued.wait_until(guard, oldestPending + COMMIT_INTERVAL,
+                [this] { return stopping || commitNow || pendingRecords >= COMMIT_BATCH || pendingRecords == 0; });
+            string batch;
+            batch.swap(pending);
+            pendingRecords = 0;
+            commitNow = false;
+            uint64_t last = lastQueued;
+            writing = true;
+            guard.unlock();
+            bool written = batch.empty() || writeAndSync(batch);
+            guard.lock();
+            writing = false;
+            if (!written) failed = true;
+            lastCommitted = max(lastCommitted, last);
+            committed.notify_all();
+        }
+    }
+
+public:
+    ~Journal() {
+        close();
+    }
+
+    bool open(const string& path) {
+#ifdef _WIN32
+        fd = _open(path.c_str(), _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY, 0644);
+#else
+        fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+#endif
+        if (fd < 0) return false;
+        stopping = false;
+        writer = thread(&Journal::writeBatches, this);
+        return true;
+    }
+
+    // Records already in the file when it was opened count towards compaction too
+    void setRecordCount(size_t count) {
+        lock_guard<mutex> guard(lock);
+        records = count;
+    }
+
+    size_t recordCount() const {
+        lock_guard<mutex> guard(lock);
+        return records;
+    }
+
+    // Queue one record, which must end with '\n', and return its sequence number for waitFor;
+    // 0 if the journal is not open
+    uint64_t queue(const string& line) {
+        lock_guard<mutex> guard(lock);
+        if (fd < 0) return 0;
+        pending += line;
+        records++;
+        if (++pendingRecords == 1) oldestPending = chrono::steady_clock::now();
+        if (pendingRecords == 1 || pendingRecords >= COMMIT_BATCH) queued.notify_one();
+        return ++lastQueued;
+    }
+
+    // Commit now rather than at the end of the interval, and wait until the record is on disk.
+    // False if a write has failed.
+    bool waitFor(uint64_t sequence) {
+        unique_lock<mutex> guard(lock);
+        if (sequence > lastCommitted) {
+            commitNow = true;
+            queued.notify_one();
+            committed.wait(guard, [&] { return lastCommitted >= sequence; });
+        }
+        return !failed;
+    }
+
+    bool append(const string& line, Durability durability = Durability::Buffered) {
+        uint64_t sequence = queue(line);
+        if (sequence == 0) return false;
+        if (durability == Durability::Synced) return waitFor(sequence);
+        lock_guard<mutex> guard(lock);
+        return !failed;
+    }
+
+    // Wait until every record queued so far is on disk
+    void sync() {
+        uint64_t last;
+        {
+            lock_guard<mutex> guard(lock);
+            if (fd < 0) return;
+            last = lastQueued;
+        }
+        waitFor(last);
+    }
+
+    // Drop every record, once a snapshot holds their effects; whoever waits for one is released
+    void clear() {
+        unique_lock<mutex> guard(lock);
+        if (fd < 0) return;
+        pending.clear();
+        pendingRecords = 0;
+        committed.wait(guard, [this] { return !writing; });
+#ifdef _WIN32
+        _chsize(fd, 0);
+        _commit(fd);
+#else
+        if (ftruncate(fd, 0) != 0) cerr << "Failed to truncate the journal\n";
+        fsync(fd);
+#endif
+        records = 0;
+        lastCommitted = lastQueued;
+        committed.notify_all();
+    }
+
+    // Commit what is queued and stop the writer
+    void close() {
+        {
+            lock_guard<mutex> guard(lock);
+            if (fd < 0) return;
+            stopping = true;
+            queued.notify_one();
+        }
+        writer.join();
+#ifdef _WIN32
+        _close(fd);
+#else
+        ::close(fd);
+#endif
+        fd = -1;
+    }
+};
+
+// Force a file's contents to disk before it is relied on
+void syncFile(const string& filename) {
+#ifdef _WIN32
+    int fd = _open(filename.c_str(), _O_RDWR | _O_BINARY);
+    if (fd >= 0) {
+        _commit(fd);
+        _close(fd);
+    }
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        ::close(fd);
+    }
+#endif
+}
+
+// Truncate a file to its first `length` bytes, e.g. to drop a record torn by a crash
+void truncateFile(const string& filename, size_t length) {
+#ifdef _WIN32
+    int fd = _open(filename.c_str(), _O_WRONLY | _O_BINARY);
+    if (fd >= 0) {
+        _chsize(fd, static_cast<long>(length));
+        _close(fd);
+    }
+#else
+    if (truncate(filename.c_str(), static_cast<off_t>(length)) != 0) {
+        cerr << "Failed to truncate " << filename << endl;
+    }
+#endif
+}
+
+// Compactions write each snapshot file as <file>.new and commit them all at once by creating a marker
+// file; only then are the old files replaced and the journal emptied. Run at startup, this finishes a
+// committed compaction that was interrupted, or drops an uncommitted one, so no record applies twice.
+void finishCompaction(const vector<string>& snapshots, const string& marker, const string& journalFile) {
+    bool committed = fileExists(marker);
+    for (const string& snapshot : snapshots) {
+        string pending = snapshot + ".new";
+        if (committed && fileExists(pending)) replaceFile(pending, snapshot);
+        else remove(pending.c_str());
+    }
+    if (committed) {
+        truncateFile(journalFile, 0);
+        remove(marker.c_str());
+    }
+}
+
+// Create the marker that commits a compaction's new snapshot files, which must already be synced
+bool commitCompaction(const string& marker) {
+    ofstream file(marker);
+    file.close();
+    if (!file) return false;
+    syncFile(marker);
+    return true;
+}
+
+// Local date and time of a rental, or "date unknown" for rentals recorded before times were kept
+string formatRentalTime(uint32_t seconds) {
+    if (seconds == 0) return "date unknown";
+    time_t when = seconds;
+    char text[32];
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M", localtime(&when));
+    return text;
+}
+
+// A non-empty run of decimal digits
+bool parseUnsigned(string_view text, uint64_t& value) {
+    if (text.empty() || text.size() > 19) return false;
+    value = 0;
+    for (char digit : text) {
+        if (digit < '0' || digit > '9') return false;
+        value = value * 10 + (digit - '0');
+    }
+    return true;
+}
+
+// Local midnight at the start of a "YYYY-MM-DD" date; false if the text is not a valid date
+bool parseDate(const string& text, uint32_t& seconds) {
+    tm date = {};
+    char extra;
+    if (sscanf(text.c_str(), "%4d-%2d-%2d%c", &date.tm_year, &date.tm_mon, &date.tm_mday, &extra) != 3) return false;
+    int day = date.tm_mday, month = date.tm_mon;
+    date.tm_year -= 1900;
+    date.tm_mon--;
+    date.tm_isdst = -1;
+    time_t when = mktime(&date);
+    // mktime normalizes out-of-range days, such as February 30, into another date
+    if (when <= 0 || when >= UINT32_MAX || date.tm_mday != day || date.tm_mon != month - 1) return false;
+    seconds = static_cast<uint32_t>(when);
+    return true;
+}
+
+// Local midnight at the start of the day after the one starting at `day`
+bool dayAfter(uint32_t day, uint32_t& next) {
+    time_t when = day;
+    tm date = *localtime(&when);
+    date.tm_mday++;
+    date.tm_hour = date.tm_min = date.tm_sec = 0;
+    date.tm_isdst = -1;
+    time_t after = mktime(&date);
+    if (after <= 0 || after >= UINT32_MAX) return false;
+    next = static_cast<uint32_t>(after);
+    return true;
+}
+
+// Index of the lowest set bit of a non-zero word
+inline int lowestBit(uint64_t word) {
+    int bit = 0;
+    for (int step = 32; step > 0; step /= 2) {
+        if ((word & ((uint64_t(1) << step) - 1)) == 0) {
+            word >>= step;
+            bit += step;
+        }
+    }
+    return bit;
+}
+
+// One field of a CSV line, viewing the line. A quoted field is viewed without its quotes; if it also
+// holds doubled quotes, `escaped` is set and appendTo/str undo them.
+struct CsvField {
+    string_view text;
+    bool escaped = false;
+
+    void appendTo(string& out) const {
+        if (!escaped) {
+            out.append(text);
+            return;
+        }
+        for (size_t i = 0; i < text.size(); i++) {
+            out += text[i];
+            if (text[i] == '"') i++; // The second quote of a pair
+        }
+    }
+
+    string str() const {
+        string value;
+        appendTo(value);
+        return value;
+    }
+};
+
+// Split a line into exactly N fields. A field that starts with a quote runs to the matching quote and
+// may hold commas, with "" for a quote; quotes anywhere else are ordinary characters. False for another
+// number of fields, an unterminated quote or text after a closing quote.
+template <size_t N>
+bool splitCsv(string_view line, CsvField (&fields)[N]) {
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    size_t at = 0;
+    for (size_t i = 0; i < N; i++) {
+        CsvField& field = fields[i];
+        field.escaped = false;
+        if (at < line.size() && line[at] == '"') {
+            size_t start = ++at;
+            size_t quote;
+            while ((quote = line.find('"', at)) != string_view::npos && quote + 1 < line.size() && line[quote + 1] == '"') {
+                field.escaped = true;
+                at = quote + 2;
+            }
+            if (quote == string_view::npos) return false;
+            field.text = line.substr(start, quote - start);
+            at = quote + 1;
+        }
+        else {
+            size_t comma = min(line.find(',', at), line.size());
+            field.text = line.substr(at, comma - at);
+            at = comma;
+        }
+        if (at == line.size()) {
+            if (i + 1 < N) return false;
+        }
+        else if (line[at] != ',' || i + 1 == N) {
+            return false;
+        }
+        at++;
+    }
+    return true;
+}
+
+void appendQuotedField(string& out, string_view text) {
+    out += '"';
+    for (char c : text) {
+        out += c;
+        if (c == '"') out += '"';
+    }
+    out += '"';
+}
+
+// Append a field, quoted if it holds a comma or a quote
+void appendCsvField(string& out, string_view text) {
+    if (text.find_first_of(",\"\r\n") == string_view::npos) out.append(text);
+    else appendQuotedField(out, text);
+}
+
+// Append a "name,description,price,available" line without its newline
+void appendItemLine(string& out, string_view name, string_view description, double price, bool available) {
+    appendCsvField(out, name);
+    out += ',';
+    appendCsvField(out, description);
+    out += ',';
+    out += to_string(price);
+    out += available ? ",1" : ",0";
+}
+
+// The fields of a "name,description,price,available" line
+struct ItemFields {
+    CsvField name, description;
+    double price = 0;
+    bool available = false;
+
+    // False if the line is not a valid item. An unquoted line with extra commas is read the way
+    // items.txt was written before fields were quoted: the extra commas belong to the description.
+    bool parse(string_view line) {
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        CsvField fields[4];
+        if (!splitCsv(line, fields)) {
+            size_t first = line.find(','), last = line.rfind(',');
+            size_t beforeLast = last == string_view::npos || last == 0 ? string_view::npos : line.rfind(',', last - 1);
+            if (line.find('"') != string_view::npos || beforeLast == string_view::npos || beforeLast <= first) return false;
+            fields[0].text = line.substr(0, first);
+            fields[1].text = line.substr(first + 1, beforeLast - first - 1);
+            fields[2].text = line.substr(beforeLast + 1, last - beforeLast - 1);
+            fields[3].text = line.substr(last + 1);
+        }
+        name = fields[0];
+        description = fields[1];
+        char number[64];
+        string_view priceText = fields[2].text;
+        if (priceText.empty() || priceText.size() >= sizeof(number)) return false;
+        memcpy(number, priceText.data(), priceText.size());
+        number[priceText.size()] = '\0';
+        char* end;
+        price = strtod(number, &end);
+        // strtod also reads "nan" and "inf"; a NaN price would break the ordering of the price index
+        if (*end != '\0' || !isfinite(price) || price < 0) return false;
+        available = fields[3].text == "1";
+        return true;
+    }
+};
+
+// Class for item
+class Item {
+    string name, description;
+    double rentalPrice;
+    bool isAvailable;
+
+public:
+    Item(string name, string description, double rentalPrice, bool isAvailable)
+        : name(name), description(description), rentalPrice(rentalPrice), isAvailable(isAvailable) {}
+
+    const string& getName() const { return name; }
+    const string& getDescription() const { return description; }
+    double getPrice() const { return rentalPrice; }
+    bool checkAvailability() const { return isAvailable; }
+
+    void markUnavailable() { isAvailable = false; }
+    void markAvailable() { isAvailable = true; }
+
+    void displayItem() const {
+        cout << "Name: " << name << ", Description: " << description
+            << ", Price: $" << rentalPrice << ", Available: " << (isAvailable ? "Yes" : "No") << "\n";
+    }
+
+    string toString() const {
+        string line;
+        appendItemLine(line, name, description, rentalPrice, isAvailable);
+        return line;
+    }
+
+    // Read an item from a line written by toString; false, leaving `item` alone, if it is not valid
+    static bool fromString(string_view line, Item& item) {
+        ItemFields fields;
+        if (!fields.parse(line)) return false;
+        item = Item(fields.name.str(), fields.description.str(), fields.price, fields.available);
+        return true;
+    }
+};
+
+// Base Class: User. The strings live in the user store's string arena, which outlives every user.
+class User {
+protected:
+    string_view name, email, password;
+
+public:
+    User(string_view name, string_view email, string_view password)
+        : name(name), email(email), password(password) {}
+    virtual ~User() = default;
+
+    string_view getEmail() const { return email; }
+    string_view getPassword() const { return password; }
+    virtual const char* getRole() const = 0;
+
+    virtual void displayMenu(class RentalManager& rentalManager) = 0; // Pure virtual function
+
+    string toString() const {
+        string line;
+        line.reserve(name.size() + email.size() + password.size() + 10);
+        appendCsvField(line, name);
+        line += ',';
+        appendCsvField(line, email);
+        line += ',';
+        appendCsvField(line, password);
+        line.append(",").append(getRole());
+        return line;
+    }
+};
+
+// Derived Class: Admin
+class Admin : public User {
+public:
+    Admin(string_view name, string_view email, string_view password)
+        : User(name, email, password) {}
+
+    const char* getRole() const override { return "Admin"; }
+    void displayMenu(class RentalManager& rentalManager) override;
+};
+
+// Derived Class Renter
+class Renter : public User {
+public:
+    Renter(string_view name, string_view email, string_view password)
+        : User(name, email, password) {}
+
+    const char* getRole() const override { return "Renter"; }
+    void displayMenu(class RentalManager& rentalManager) override;
+};
+
+// Read-only memory map of a whole file
+class MappedFile {
+    const char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        close();
+    }
+
+    bool open(const string& path) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        length = static_cast<size_t>(fileSize.QuadPart);
+        if (length == 0) return true;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        bytes = mapping ? static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            return false;
+        }
+        length = static_cast<size_t>(info.st_size);
+        if (length == 0) {
+            ::close(fd);
+            return true;
+        }
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // The mapping keeps the file alive
+        bytes = mapped == MAP_FAILED ? nullptr : static_cast<const char*>(mapped);
+#endif
+        if (!bytes) close();
+        return bytes != nullptr;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (bytes) UnmapViewOfFile(bytes);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (bytes) munmap(const_cast<char*>(bytes), length);
+#endif
+        bytes = nullptr;
+        length = 0;
+    }
+
+    const char* data() const {
+        return bytes;
+    }
+
+    size_t size() const {
+        return length;
+    }
+};
+
+// Binary catalogue (items.bin): a header, one fixed-width record per item, then a string table with
+// each item's name immediately followed by its description. Little-endian as written on x86 and ARM.
+struct CatalogueHeader {
+    char magic[4];        // "ICAT"
+    uint32_t version;
+    uint64_t itemCount;
+    uint64_t stringTableSize;
+};
+
+struct CatalogueRecord {
+    uint64_t nameOffset;  // Into the string table
+    uint32_t nameLength;
+    uint32_t descriptionLength;
+    double rentalPrice;
+    uint8_t available;
+    uint8_t padding[7];
+};
+
+const char CATALOGUE_MAGIC[4] = { 'I', 'C', 'A', 'T' };
+const uint32_t CATALOGUE_VERSION = 1;
+
+// A binary catalogue used in place through a memory map; items are only built when asked for
+class Catalogue {
+    MappedFile file;
+    const char* records = nullptr;
+    const char* strings = nullptr;
+    size_t count = 0;
+
+    CatalogueRecord record(size_t index) const {
+        CatalogueRecord result;
+        memcpy(&result, records + index * sizeof(CatalogueRecord), sizeof(result));
+        return result;
+    }
+
+public:
+    // False if the file is missing, of another version, or has a record pointing outside the string table
+    bool open(const string& path) {
+        close();
+        CatalogueHeader header;
+        if (!file.open(path) || file.size() < sizeof(header)) return false;
+        memcpy(&header, file.data(), sizeof(header));
+        size_t available = file.size() - sizeof(header);
+        if (memcmp(header.magic, CATALOGUE_MAGIC, sizeof(CATALOGUE_MAGIC)) != 0 || header.version != CATALOGUE_VERSION
+            || header.itemCount > available / sizeof(CatalogueRecord)
+            || header.stringTableSize != available - header.itemCount * sizeof(CatalogueRecord)) {
+            close();
+            return false;
+        }
+        records = file.data() + sizeof(header);
+        strings = records + header.itemCount * sizeof(CatalogueRecord);
+        count = static_cast<size_t>(header.itemCount);
+        for (size_t i = 0; i < count; i++) {
+            CatalogueRecord entry = record(i);
+            if (entry.nameOffset > header.stringTableSize
+                || uint64_t(entry.nameLength) + entry.descriptionLength > header.stringTableSize - entry.nameOffset) {
+                close();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void close() {
+        file.close();
+        records = strings = nullptr;
+        count = 0;
+    }
+
+    bool isOpen() const {
+        return records != nullptr;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    string_view name(size_t index) const {
+        CatalogueRecord entry = record(index);
+        return string_view(strings + entry.nameOffset, entry.nameLength);
+    }
+
+    string_view description(size_t index) const {
+        CatalogueRecord entry = record(index);
+        return string_view(strings + entry.nameOffset + entry.nameLength, entry.descriptionLength);
+    }
+
+    double price(size_t index) const {
+        return record(index).rentalPrice;
+    }
+
+    bool available(size_t index) const {
+        return record(index).available != 0;
+    }
+
+    Item item(size_t index) const {
+        CatalogueRecord entry = record(index);
+        const char* name = strings + entry.nameOffset;
+        return Item(string(name, entry.nameLength), string(name + entry.nameLength, entry.descriptionLength),
+            entry.rentalPrice, entry.available != 0);
+    }
+};
+
+// The records and string table of a binary catalogue being built. Builders filled on separate threads
+// are joined in order with append.
+class CatalogueBuilder {
+    vector<CatalogueRecord> records;
+    string strings;
+
+    void addRecord(size_t nameOffset, double price, bool available) {
+        CatalogueRecord entry = CatalogueRecord();
+        entry.nameOffset = nameOffset;
+        entry.nameLength = static_cast<uint32_t>(strings.size() - nameOffset);
+        entry.rentalPrice = price;
+        entry.available = available ? 1 : 0;
+        records.push_back(entry);
+    }
+
+public:
+    size_t size() const {
+        return records.size();
+    }
+
+    void add(string_view name, string_view description, double price, bool available) {
+        size_t offset = strings.size();
+        strings += name;
+        addRecord(offset, price, available);
+        strings += description;
+        records.back().descriptionLength = static_cast<uint32_t>(description.size());
+    }
+
+    void add(const Item& item) {
+        add(item.getName(), item.getDescription(), item.getPrice(), item.checkAvailability());
+    }
+
+    // Copies the fields straight into the string table, undoing any CSV quoting on the way
+    void add(const ItemFields& fields) {
+        size_t offset = strings.size();
+        fields.name.appendTo(strings);
+        addRecord(offset, fields.price, fields.available);
+        size_t descriptionStart = strings.size();
+        fields.description.appendTo(strings);
+        records.back().descriptionLength = static_cast<uint32_t>(strings.size() - descriptionStart);
+    }
+
+    Item item(size_t index) const {
+        const CatalogueRecord& entry = records[index];
+        const char* name = strings.data() + entry.nameOffset;
+        return Item(string(name, entry.nameLength), string(name + entry.nameLength, entry.descriptionLength),
+            entry.rentalPrice, entry.available != 0);
+    }
+
+    // Write the parts, in order, as one catalogue without joining them in memory
+    static bool write(const string& path, const vector<const CatalogueBuilder*>& parts) {
+        ofstream file(path, ios::binary | ios::trunc);
+        if (!file) return false;
+        CatalogueHeader header;
+        memcpy(header.magic, CATALOGUE_MAGIC, sizeof(CATALOGUE_MAGIC));
+        header.version = CATALOGUE_VERSION;
+        header.itemCount = 0;
+        header.stringTableSize = 0;
+        for (const CatalogueBuilder* part : parts) {
+            header.itemCount += part->records.size();
+            header.stringTableSize += part->strings.size();
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        // Each part's name offsets move up by the strings of the parts before it
+        const size_t BATCH = 4096;
+        vector<CatalogueRecord> shifted;
+        size_t stringsBefore = 0;
+        for (const CatalogueBuilder* part : parts) {
+            for (size_t first = 0; first < part->records.size(); first += BATCH) {
+                shifted.assign(part->records.begin() + first, part->records.begin() + min(first + BATCH, part->records.size()));
+                for (CatalogueRecord& entry : shifted) {
+                    entry.nameOffset += stringsBefore;
+                }
+                file.write(reinterpret_cast<const char*>(shifted.data()), shifted.size() * sizeof(CatalogueRecord));
+            }
+            stringsBefore += part->strings.size();
+        }
+        for (const CatalogueBuilder* part : parts) {
+            file.write(part->strings.data(), part->strings.size());
+        }
+        file.close();
+        return !file.fail();
+    }
+
+    bool write(const string& path) const {
+        return write(path, { this });
+    }
+};
+
+// Write `count` items, as returned by itemAt(index), to a binary catalogue
+template <typename ItemAt>
+bool writeCatalogue(const string& path, size_t count, ItemAt itemAt) {
+    CatalogueBuilder builder;
+    for (size_t i = 0; i < count; i++) {
+        builder.add(itemAt(i));
+    }
+    return builder.write(path);
+}
+
+// Parse the non-empty lines of `text` on several threads. The text is cut at line ends into one range
+// per thread, and parseLine(line, chunk) adds to that range's own Chunk, so the threads share nothing.
+// Returns the chunks in order. `rejected` counts the lines parseLine refused and `firstRejected` is
+// the line number of the first of them (0 if none).
+template <typename Chunk, typename ParseLine>
+vector<Chunk> parseLinesInParallel(string_view text, ParseLine parseLine, size_t& rejected, size_t& firstRejected) {
+    const size_t MIN_RANGE = 1 << 16; // Smaller files are not worth a thread
+    size_t parts = min<size_t>(max(1u, thread::hardware_concurrency()), text.size() / MIN_RANGE + 1);
+    vector<string_view> ranges;
+    for (size_t part = 1, start = 0; start < text.size(); part++) {
+        size_t end = part >= parts ? string_view::npos : text.find('\n', max(start, text.size() * part / parts));
+        end = end == string_view::npos ? text.size() : end + 1;
+        ranges.push_back(text.substr(start, end - start));
+        start = end;
+    }
+
+    vector<Chunk> chunks(ranges.size());
+    vector<size_t> lineCounts(ranges.size(), 0), rejectedCounts(ranges.size(), 0), firstRejectedLines(ranges.size(), 0);
+    auto parseRange = [&](size_t part) {
+        string_view range = ranges[part];
+        size_t lines = 0;
+        while (!range.empty()) {
+            size_t newline = min(range.find('\n'), range.size());
+            string_view line = range.substr(0, newline);
+            range.remove_prefix(min(newline + 1, range.size()));
+            lines++;
+            if (line.empty() || line == "\r") continue;
+            if (!parseLine(line, chunks[part]) && rejectedCounts[part]++ == 0) firstRejectedLines[part] = lines;
+        }
+        lineCounts[part] = lines;
+    };
+    vector<thread> workers;
+    for (size_t part = 1; part < ranges.size(); part++) {
+        workers.emplace_back(parseRange, part);
+    }
+    if (!ranges.empty()) parseRange(0);
+    for (thread& worker : workers) {
+        worker.join();
+    }
+
+    rejected = 0;
+    firstRejected = 0;
+    size_t linesBefore = 0;
+    for (size_t part = 0; part < ranges.size(); part++) {
+        if (firstRejected == 0 && rejectedCounts[part] > 0) firstRejected = linesBefore + firstRejectedLines[part];
+        rejected += rejectedCounts[part];
+        linesBefore += lineCounts[part];
+    }
+    return chunks;
+}
+
+// Write `count` lines to a file, formatting them on several threads a batch at a time;
+// format(index, out) appends line `index` with its newline
+template <typename Format>
+bool writeLinesInParallel(const string& path, size_t count, Format format) {
+    const size_t LINES_PER_PART = 1 << 15;
+    size_t parts = max(1u, thread::hardware_concurrency());
+    vector<string> texts(parts);
+    ofstream file(path, ios::binary | ios::trunc);
+    for (size_t batch = 0; batch < count && file; batch += parts * LINES_PER_PART) {
+        auto formatPart = [&](size_t part) {
+            texts[part].clear();
+            size_t first = min(count, batch + part * LINES_PER_PART);
+            for (size_t index = first; index < min(count, first + LINES_PER_PART); index++) {
+                format(index, texts[part]);
+            }
+        };
+        vector<thread> workers;
+        for (size_t part = 1; part < parts && batch + part * LINES_PER_PART < count; part++) {
+            workers.emplace_back(formatPart, part);
+        }
+        formatPart(0);
+        for (thread& worker : workers) {
+            worker.join();
+        }
+        for (size_t part = 0; part <= workers.size(); part++) {
+            file.write(texts[part].data(), texts[part].size());
+        }
+    }
+    file.close();
+    return !file.fail();
+}
+
+// Parse an items CSV file on several threads into consecutive chunks of `items`; false if it cannot be read
+bool readItemsCsv(const string& path, vector<CatalogueBuilder>& items, size_t& rejected, size_t& firstRejected) {
+    MappedFile file;
+    if (!file.open(path)) return false;
+    items = parseLinesInParallel<CatalogueBuilder>(string_view(file.data(), file.size()),
+        [](string_view line, CatalogueBuilder& chunk) {
+            ItemFields fields;
+            if (!fields.parse(line)) return false;
+            chunk.add(fields);
+            return true;
+        }, rejected, firstRejected);
+    return true;
+}
+
+size_t totalItems(const vector<CatalogueBuilder>& chunks) {
+    size_t total = 0;
+    for (const CatalogueBuilder& chunk : chunks) {
+        total += chunk.size();
+    }
+    return total;
+}
+
+// One bit per item, set while the item is available. The words are atomic so concurrent reservations
+// claim an item with a single atomic read-modify-write; a deque keeps existing words in place as items
+// are added. Growing is single-threaded.
+class AvailabilityBits {
+    deque<atomic<uint64_t>> words;
+
+public:
+    size_t wordCount() const {
+        return words.size();
+    }
+
+    uint64_t word(size_t index) const {
+        return words[index].load(memory_order_relaxed);
+    }
+
+    void resize(size_t itemCount) {
+        while (words.size() * 64 < itemCount) words.emplace_back(0);
+    }
+
+    bool test(size_t index) const {
+        return word(index / 64) >> (index % 64) & 1;
+    }
+
+    void set(size_t index, bool available) {
+        uint64_t mask = uint64_t(1) << (index % 64);
+        if (available) words[index / 64].fetch_or(mask, memory_order_acq_rel);
+        else words[index / 64].fetch_and(~mask, memory_order_acq_rel);
+    }
+
+    // Clear the bit; true only for the one caller that found it set
+    bool claim(size_t index) {
+        uint64_t mask = uint64_t(1) << (index % 64);
+        return (words[index / 64].fetch_and(~mask, memory_order_acq_rel) & mask) != 0;
+    }
+};
+
+// A parsed search such as "available AND 'drill' AND price < 20": every condition must hold.
+// Words and quoted phrases must appear in the name or description; price bounds form a closed range.
+struct SearchQuery {
+    vector<string> terms;
+    double minPrice = -numeric_limits<double>::infinity();
+    double maxPrice = numeric_limits<double>::infinity();
+    bool availableOnly = false;
+
+    bool hasPriceRange() const {
+        return minPrice > -numeric_limits<double>::infinity() || maxPrice < numeric_limits<double>::infinity();
+    }
+
+    // Call visit(token) for each lowercase run of letters and digits; `buffer` holds the token
+    template <typename Visit>
+    static void forEachToken(string_view text, string& buffer, Visit visit) {
+        buffer.clear();
+        for (char c : text) {
+            if (isalnum(static_cast<unsigned char>(c))) {
+                buffer += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+            }
+            else if (!buffer.empty()) {
+                visit(string_view(buffer));
+                buffer.clear();
+            }
+        }
+        if (!buffer.empty()) visit(string_view(buffer));
+    }
+
+    // Conditions are separated by AND (or just spaces); on failure `error` says what was wrong
+    static bool parse(const string& text, SearchQuery& query, string& error) {
+        // Split into quoted phrases, comparison operators and words
+        vector<pair<char, string>> lexemes; // '"' phrase, '<' operator, 'w' word
+        for (size_t i = 0; i < text.size();) {
+            char c = text[i];
+            if (isspace(static_cast<unsigned char>(c))) {
+                i++;
+            }
+            else if (c == '\'' || c == '"') {
+                size_t close = text.find(c, i + 1);
+                if (close == string::npos) {
+                    error = "unterminated quote";
+                    return false;
+                }
+                lexemes.push_back({ '"', text.substr(i + 1, close - i - 1) });
+                i = close + 1;
+            }
+            else if (c == '<' || c == '>' || c == '=') {
+                size_t length = (c != '=' && i + 1 < text.size() && text[i + 1] == '=') ? 2 : 1;
+                lexemes.push_back({ '<', text.substr(i, length) });
+                i += length;
+            }
+            else {
+                size_t end = i;
+                while (end < text.size() && !isspace(static_cast<unsigned char>(text[end])) && text[end] != '\''
+                    && text[end] != '"' && text[end] != '<' && text[end] != '>' && text[end] != '=') {
+                    end++;
+                }
+                string word = text.substr(i, end - i);
+                transform(word.begin(), word.end(), word.begin(), [](unsigned char ch) { return static_cast<char>(tolower(ch)); });
+                lexemes.push_back({ 'w', word });
+                i = end;
+            }
+        }
+
+        query = SearchQuery();
+        bool any = false;
+        for (size_t i = 0; i < lexemes.size(); i++) {
+            const string& value = lexemes[i].second;
+            if (lexemes[i].first == 'w' && value == "and") continue;
+            if (lexemes[i].first == 'w' && value == "available") {
+                query.availableOnly = true;
+            }
+            else if (lexemes[i].first == 'w' && value == "price") {
+                if (i + 2 >= lexemes.size() || lexemes[i + 1].first != '<' || lexemes[i + 2].first != 'w') {
+                    error = "price must be followed by <, <=, >, >= or = and a number";
+                    return false;
+                }
+                const string& op = lexemes[i + 1].second;
+                string number = lexemes[i + 2].second;
+                if (!number.empty() && number[0] == '$') number.erase(0, 1);
+                char* end = nullptr;
+                double bound = strtod(number.c_str(), &end);
+                if (number.empty() || *end != '\0' || std::isnan(bound)) {
+                    error = "'" + lexemes[i + 2].second + "' is not a price";
+                    return false;
+                }
+                // Strict bounds become the next representable value so the range stays closed
+                if (op == "<") query.maxPrice = min(query.maxPrice, nextafter(bound, -numeric_limits<double>::infinity()));
+                else if (op == "<=") query.maxPrice = min(query.maxPrice, bound);
+                else if (op == ">") query.minPrice = max(query.minPrice, nextafter(bound, numeric_limits<double>::infinity()));
+                else if (op == ">=") query.minPrice = max(query.minPrice, bound);
+                else {
+                    query.minPrice = max(query.minPrice, bound);
+                    query.maxPrice = min(query.maxPrice, bound);
+                }
+                i += 2;
+            }
+            else if (lexemes[i].first == '<') {
+                error = "'" + value + "' must follow price";
+                return false;
+            }
+            else {
+                size_t before = query.terms.size();
+                string buffer;
+                forEachToken(value, buffer, [&](string_view token) { query.terms.emplace_back(token); });
+                if (query.terms.size() == before) {
+                    error = "'" + value + "' has no letters or digits to search for";
+                    return false;
+                }
+            }
+            any = true;
+        }
+        if (!any) {
+            error = "nothing to search for";
+            return false;
+        }
+        sort(query.terms.begin(), query.terms.end());
+        query.terms.erase(unique(query.terms.begin(), query.terms.end()), query.terms.end());
+        return true;
+    }
+};
+
+// Search over the catalogue: an inverted index from each name and description token to the items
+// containing it (in index order, since items are only ever appended), and the item indexes sorted by
+// price for range queries. New items go to a small unsorted tail that is merged in once it fills, so
+// adding an item never moves the whole price index. Availability comes from the caller's bitset.
+class SearchIndex {
+    static constexpr size_t MAX_PRICE_TAIL = 4096;
+
+    deque<string> tokens; // deque so the views used as keys never move
+    unordered_map<string_view, uint32_t> tokenIds;
+    vector<vector<uint32_t>> postings; // By token ID
+    vector<double> prices;
+    vector<uint32_t> byPrice;
+    vector<uint32_t> priceTail;
+    string buffer; // Reused between adds
+    bool built = false; // Until finishBuild, every item waits in the tail
+
+    bool priceBefore(uint32_t a, uint32_t b) const {
+        return prices[a] != prices[b] ? prices[a] < prices[b] : a < b;
+    }
+
+    void mergePriceTail() {
+        auto before = [this](uint32_t a, uint32_t b) { return priceBefore(a, b); };
+        sort(priceTail.begin(), priceTail.end(), before);
+        size_t middle = byPrice.size();
+        byPrice.insert(byPrice.end(), priceTail.begin(), priceTail.end());
+        inplace_merge(byPrice.begin(), byPrice.begin() + middle, byPrice.end(), before);
+        priceTail.clear();
+    }
+
+public:
+    struct Result {
+        vector<uint32_t> items; // The first matches in index order
+        bool more = false;      // There are matches beyond those
+    };
+
+    size_t size() const {
+        return prices.size();
+    }
+
+    // Items must be added in index order, starting from 0
+    void add(string_view name, string_view description, double price) {
+        uint32_t item = static_cast<uint32_t>(prices.size());
+        auto index = [&](string_view token) {
+            auto found = tokenIds.find(token);
+            if (found == tokenIds.end()) {
+                tokens.emplace_back(token);
+                found = tokenIds.emplace(tokens.back(), static_cast<uint32_t>(postings.size())).first;
+                postings.emplace_back();
+            }
+            vector<uint32_t>& list = postings[found->second];
+            if (list.empty() || list.back() != item) list.push_back(item);
+        };
+        SearchQuery::forEachToken(name, buffer, index);
+        SearchQuery::forEachToken(description, buffer, index);
+        prices.push_back(price);
+        priceTail.push_back(item);
+        if (built && priceTail.size() >= MAX_PRICE_TAIL) mergePriceTail();
+    }
+
+    // Sorting every item once is cheaper than merging one tail at a time when building from scratch
+    void finishBuild() {
+        built = true;
+        // Sorting the prices alongside the IDs avoids a lookup into prices for every comparison
+        vector<pair<double, uint32_t>> order;
+        order.reserve(byPrice.size() + priceTail.size());
+        for (uint32_t item : byPrice) order.emplace_back(prices[item], item);
+        for (uint32_t item : priceTail) order.emplace_back(prices[item], item);
+        priceTail.clear();
+        sort(order.begin(), order.end());
+        byPrice.resize(order.size());
+        for (size_t i = 0; i < order.size(); i++) byPrice[i] = order[i].second;
+    }
+
+    // The first `limit` matches in index order. Candidates come from scanning the rarest term's items
+    // (or every item) until enough match, or from sorting the price range when that is estimated to be
+    // cheaper; the other conditions are checked per candidate, cheapest first.
+    Result search(const SearchQuery& query, const AvailabilityBits& availableBits, size_t limit) const {
+        Result result;
+        vector<const vector<uint32_t>*> lists;
+        for (const string& term : query.terms) {
+            auto found = tokenIds.find(term);
+            if (found == tokenIds.end()) return result;
+            lists.push_back(&postings[found->second]);
+        }
+        sort(lists.begin(), lists.end(), [](const vector<uint32_t>* a, const vector<uint32_t>* b) { return a->size() < b->size(); });
+
+        size_t scanSize = lists.empty() ? prices.size() : lists[0]->size();
+        vector<uint32_t> fromPrice;
+        bool useFromPrice = false;
+        if (query.hasPriceRange()) {
+            auto low = partition_point(byPrice.begin(), byPrice.end(), [&](uint32_t item) { return prices[item] < query.minPrice; });
+            auto high = partition_point(low, byPrice.end(), [&](uint32_t item) { return prices[item] <= query.maxPrice; });
+            size_t inRange = static_cast<size_t>(high - low) + priceTail.size();
+            // A scan stops after about limit / (share of items in range) candidates
+            double scanCost = min<double>(scanSize, (limit + 1.0) * prices.size() / max<size_t>(inRange, 1));
+            double sortCost = inRange * log2(inRange + 2.0);
+            if (sortCost < scanCost) {
+                useFromPrice = true;
+                fromPrice.assign(low, high);
+                for (uint32_t item : priceTail) {
+                    if (prices[item] >= query.minPrice && prices[item] <= query.maxPrice) fromPrice.push_back(item);
+                }
+                sort(fromPrice.begin(), fromPrice.end());
+            }
+        }
+
+        // Candidates arrive in increasing order, so each term list is searched forward from where the last
+        // candidate left it
+        vector<size_t> cursors(lists.size(), 0);
+        size_t firstList = useFromPrice ? 0 : 1;
+        auto matches = [&](uint32_t item) {
+            if (query.availableOnly && !availableBits.test(item)) return false;
+            if (prices[item] < query.minPrice || prices[item] > query.maxPrice) return false;
+            for (size_t i = firstList; i < lists.size(); i++) {
+                const vector<uint32_t>& list = *lists[i];
+                size_t& at = cursors[i];
+                size_t step = 1;
+                while (at + step < list.size() && list[at + step] < item) step *= 2;
+                at = lower_bound(list.begin() + at, list.begin() + min(at + step + 1, list.size()), item) - list.begin();
+                if (at == list.size() || list[at] != item) return false;
+            }
+            return true;
+        };
+        // False once enough have been found
+        auto keep = [&](uint32_t item) {
+            if (!matches(item)) return true;
+            if (result.items.size() == limit) {
+                result.more = true;
+                return false;
+            }
+            result.items.push_back(item);
+            return true;
+        };
+
+        if (useFromPrice || !lists.empty()) {
+            for (uint32_t item : useFromPrice ? fromPrice : *lists[0]) {
+                if (!keep(item)) break;
+            }
+        }
+        else if (query.availableOnly) {
+            for (size_t word = 0; word < availableBits.wordCount() && !result.more; word++) {
+                for (uint64_t bits = availableBits.word(word); bits != 0; bits &= bits - 1) {
+                    uint32_t item = static_cast<uint32_t>(word * 64 + lowestBit(bits));
+                    if (item >= prices.size() || !keep(item)) break;
+                }
+            }
+        }
+        else {
+            for (uint32_t item = 0; item < prices.size(); item++) {
+                if (!keep(item)) break;
+            }
+        }
+        return result;
+    }
+};
+
+// Rental history as a columnar log: each rental is an interned item ID, a time (Unix seconds, 0 if
+// unknown) and the offset of the same user's previous rental, 12 bytes in all. Users and item names are
+// interned once; lastRental holds each user's newest offset, so a user's history is a walk back along
+// their own chain and never a scan of the log.
+class RentalHistory {
+    static constexpr uint32_t NO_RENTAL = UINT32_MAX;
+
+    deque<string> userEmails; // deque so the views used as keys never move
+    unordered_map<string_view, uint32_t> userIds;
+    vector<uint32_t> lastRental;
+
+    deque<string> itemNames;
+    unordered_map<string_view, uint32_t> itemIds;
+    vector<uint32_t> rentalCounts; // Per item, for popularity
+
+    vector<uint32_t> rentalItem;
+    vector<uint32_t> rentalTime;
+    vector<uint32_t> previousOfUser;
+
+    static uint32_t intern(string_view text, deque<string>& names, unordered_map<string_view, uint32_t>& ids) {
+        auto found = ids.find(text);
+        if (found != ids.end()) return found->second;
+        uint32_t id = static_cast<uint32_t>(names.size());
+        names.emplace_back(text);
+        ids.emplace(names.back(), id);
+        return id;
+    }
+
+    uint32_t internUser(string_view email) {
+        uint32_t user = intern(email, userEmails, userIds);
+        if (user == lastRental.size()) lastRental.push_back(NO_RENTAL);
+        return user;
+    }
+
+    void recordFor(uint32_t user, string_view item, uint32_t time) {
+        uint32_t itemId = intern(item, itemNames, itemIds);
+        if (itemId == rentalCounts.size()) rentalCounts.push_back(0);
+        rentalCounts[itemId]++;
+
+        rentalItem.push_back(itemId);
+        rentalTime.push_back(time);
+        previousOfUser.push_back(lastRental[user]);
+        lastRental[user] = static_cast<uint32_t>(rentalItem.size() - 1);
+    }
+
+public:
+    struct Rental {
+        string_view item;
+        uint32_t time;
+    };
+
+    void record(string_view email, string_view item, uint32_t time) {
+        recordFor(internUser(email), item, time);
+    }
+
+    size_t size() const {
+        return rentalItem.size();
+    }
+
+    // A page of a user's rentals with times in [from, to], newest first: skip `offset` matches, return up to `limit`
+    vector<Rental> query(string_view email, uint32_t from, uint32_t to, size_t offset, size_t limit) const {
+        vector<Rental> page;
+        auto found = userIds.find(email);
+        if (found == userIds.end()) return page;
+        for (uint32_t rental = lastRental[found->second]; rental != NO_RENTAL && page.size() < limit;
+            rental = previousOfUser[rental]) {
+            if (rentalTime[rental] > to || rentalTime[rental] < from) continue;
+            if (offset > 0) {
+                offset--;
+                continue;
+            }
+            page.push_back({ itemNames[rentalItem[rental]], rentalTime[rental] });
+        }
+        return page;
+    }
+
+    // The `count` most rented item names with how often each was rented
+    vector<pair<string_view, uint32_t>> mostPopular(size_t count) const {
+        vector<uint32_t> order(rentalCounts.size());
+        for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+        count = min(count, order.size());
+        partial_sort(order.begin(), order.begin() + count, order.end(), [&](uint32_t a, uint32_t b) {
+            return rentalCounts[a] != rentalCounts[b] ? rentalCounts[a] > rentalCounts[b] : a < b;
+        });
+        vector<pair<string_view, uint32_t>> top;
+        for (size_t i = 0; i < count; i++) {
+            top.emplace_back(itemNames[order[i]], rentalCounts[order[i]]);
+        }
+        return top;
+    }
+
+    // Lines are "email:item,item|time,"; items without "|time" were recorded before times were kept.
+    // Item names holding ',', '|' or '"' are quoted as in CSV.
+    void load(const string& filename) {
+        ifstream file(filename);
+        string line, unquoted;
+        while (getline(file, line)) {
+            string_view rest(line);
+            size_t colon = rest.find(':');
+            if (colon == string_view::npos) continue;
+            uint32_t user = internUser(rest.substr(0, colon));
+            rest.remove_prefix(colon + 1);
+            while (!rest.empty()) {
+                string_view entry;
+                if (rest[0] == '"') {
+                    // The quoted name, then "|time" as usual
+                    CsvField name;
+                    size_t quote = 0;
+                    while ((quote = rest.find('"', quote + 1)) != string_view::npos && quote + 1 < rest.size() && rest[quote + 1] == '"') {
+                        quote++;
+                        name.escaped = true;
+                    }
+                    if (quote == string_view::npos) break;
+                    name.text = rest.substr(1, quote - 1);
+                    unquoted = name.str();
+                    size_t comma = rest.find(',', quote);
+                    entry = rest.substr(quote + 1, comma == string_view::npos ? string_view::npos : comma - quote - 1);
+                    rest.remove_prefix(comma == string_view::npos ? rest.size() : comma + 1);
+                    uint32_t time = 0;
+                    for (char digit : entry) {
+                        if (digit >= '0' && digit <= '9') time = time * 10 + (digit - '0');
+                    }
+                    recordFor(user, unquoted, time);
+                    continue;
+                }
+                size_t comma = rest.find(',');
+                entry = rest.substr(0, comma);
+                rest.remove_prefix(comma == string_view::npos ? rest.size() : comma + 1);
+                uint32_t time = 0;
+                size_t bar = entry.rfind('|');
+                if (bar != string_view::npos) {
+                    for (char digit : entry.substr(bar + 1)) {
+                        if (digit >= '0' && digit <= '9') time = time * 10 + (digit - '0');
+                    }
+                    entry = entry.substr(0, bar);
+                }
+                if (!entry.empty()) recordFor(user, entry, time);
+            }
+        }
+    }
+
+    // One line per user with their rentals oldest first; false if the file could not be written in full
+    bool save(const string& filename) const {
+        ofstream file(filename);
+        vector<uint32_t> chain;
+        for (uint32_t user = 0; user < userEmails.size(); user++) {
+            chain.clear();
+            for (uint32_t rental = lastRental[user]; rental != NO_RENTAL; rental = previousOfUser[rental]) {
+                chain.push_back(rental);
+            }
+            string text = userEmails[user] + ":";
+            for (auto rental = chain.rbegin(); rental != chain.rend(); ++rental) {
+                const string& name = itemNames[rentalItem[*rental]];
+                if (name.find_first_of(",|\"") == string::npos) text += name;
+                else appendQuotedField(text, name);
+                if (rentalTime[*rental] != 0) text += "|" + to_string(rentalTime[*rental]);
+                text += ",";
+            }
+            text += "\n";
+            file << text;
+        }
+        file.close();
+        return !file.fail();
+    }
+};
+
+// One item's bookings as a sorted set of disjoint [start, end) intervals in Unix seconds, keyed by start.
+// As they never overlap, the booking with the latest start before a time also ends last, so a free
+// check, booking and return are each one O(log n) lookup. A reservation has no return date and is kept
+// apart as the hold: it lasts until the item is returned, even past the start of the next booking.
+class BookingCalendar {
+public:
+    struct Booking {
+        uint32_t end;
+        string renter;
+    };
+
+private:
+    map<uint32_t, Booking> bookings;
+    set<pair<string, uint32_t>> byRenter; // (renter, start) of each booking, so a renter's next one is one lookup
+    string holder; // Empty unless the item is out on a reservation
+    uint32_t heldSince = 0;
+
+public:
+    bool empty() const {
+        return bookings.empty() && holder.empty();
+    }
+
+    const map<uint32_t, Booking>& all() const {
+        return bookings;
+    }
+
+    // True if no booking overlaps [from, to)
+    bool isFree(uint32_t from, uint32_t to) const {
+        auto next = bookings.lower_bound(to);
+        return next == bookings.begin() || prev(next)->second.end <= from;
+    }
+
+    // The booking in force at `time`, or end() if there is none
+    map<uint32_t, Booking>::const_iterator bookingAt(uint32_t time) const {
+        auto next = bookings.upper_bound(time);
+        if (next == bookings.begin() || prev(next)->second.end <= time) return bookings.end();
+        return prev(next);
+    }
+
+    // The start of the first booking after `time`, or 0 if there is none
+    uint32_t nextStart(uint32_t time) const {
+        auto next = bookings.upper_bound(time);
+        return next == bookings.end() ? 0 : next->first;
+    }
+
+    // The start of the renter's first booking after `time`, or 0 if there is none
+    uint32_t nextOf(const string& renter, uint32_t time) const {
+        auto next = byRenter.upper_bound({ renter, time });
+        return next == byRenter.end() || next->first != renter ? 0 : next->second;
+    }
+
+    bool book(uint32_t from, uint32_t to, const string& renter) {
+        if (from >= to || !isFree(from, to)) return false;
+        bookings.emplace(from, Booking{ to, renter });
+        byRenter.emplace(renter, from);
+        return true;
+    }
+
+    // Reserve the item from `since` until it is returned; false if it is held or booked at `since`.
+    // Later bookings do not stand in the way, they are when it is due back.
+    bool hold(uint32_t since, const string& renter) {
+        if (!holder.empty() || bookingAt(since) != bookings.end()) return false;
+        holder = renter;
+        heldSince = since;
+        return true;
+    }
+
+    const string& heldBy() const {
+        return holder;
+    }
+
+    uint32_t heldFrom() const {
+        return heldSince;
+    }
+
+    void unhold() {
+        holder.clear();
+        heldSince = 0;
+    }
+
+    // End the booking that starts at `start` at `time`, dropping it if it has not started by then.
+    // False if there is no such booking.
+    bool release(uint32_t start, uint32_t time) {
+        auto found = bookings.find(start);
+        if (found == bookings.end()) return false;
+        if (time <= start) {
+            byRenter.erase({ found->second.renter, start });
+            bookings.erase(found);
+        }
+        else found->second.end = min(found->second.end, time);
+        return true;
+    }
+
+    // Forget bookings over by `time`; the rental history still has them
+    void prune(uint32_t time) {
+        while (!bookings.empty() && bookings.begin()->second.end <= time) {
+            byRenter.erase({ bookings.begin()->second.renter, bookings.begin()->first });
+            bookings.erase(bookings.begin());
+        }
+    }
+};
+
+const size_t NO_ITEM = SIZE_MAX;
+
+// RentalManager Class
+class RentalManager {
+    // Items added since the catalogue was loaded, or every item when it is text; a null entry is only in
+    // the binary catalogue's mapping. availableBits, not the item, says whether an item is available.
+    vector<unique_ptr<Item>> items;
+    Catalogue catalogue;
+    bool binaryCatalogue = false; // Snapshots go to items.bin instead of items.txt
+    RentalHistory rentalHistory;
+
+    // Name -> index of the first item with that name; further items with the same name are chained
+    // through sameNameNext in catalogue order, so lookups stay O(1) even with duplicate names. Built on
+    // the first lookup so startup does not hash every name; the keys point into the mapping or the items.
+    unordered_map<string_view, size_t> itemIndex;
+    vector<size_t> sameNameNext;
+    vector<size_t> sameNameLast; // For chain heads only: the last item with that name
+    bool itemIndexBuilt = false;
+    // Bit i is set while item i is available, so browsing skips 64 unavailable items per word
+    AvailabilityBits availableBits;
+    // Keyword and price search, built on the first search like the name index; it owns its keys, so
+    // unlike the name index it survives a compaction
+    SearchIndex searchIndex;
+    bool searchIndexBuilt = false;
+    // Per item, its bookings, reservations without a return date included; null for an item without
+    // any. Bit i of bookedBits is set while item i has a calendar, so the free-window sweep skips 64
+    // items without bookings at a time. Both change under logLock; a compaction drops bookings over by then.
+    vector<unique_ptr<BookingCalendar>> calendars;
+    vector<uint64_t> bookedBits;
+
+    // Changes since the last snapshot of the items and rental_history.txt. Compaction writes a new
+    // snapshot once the journal holds a quarter of the catalogue's size in records (and at least
+    // MIN_COMPACTION_RECORDS), so every change costs O(1) I/O amortized.
+    // A snapshot is committed by creating compaction.ready once the new files are complete; startup
+    // finishes an interrupted compaction before loading, so no record is ever applied twice.
+    static constexpr size_t MIN_COMPACTION_RECORDS = 1024;
+    Journal journal;
+    // Whether a reservation or an added item is on disk before it is confirmed, or follows within the
+    // journal's commit interval. Reservations come in bulk from the server; items are added by hand.
+    Durability reservationDurability = Durability::Buffered;
+    Durability additionDurability = Durability::Synced;
+
+    // Reservations may come from several server threads at once. Each one claims its item's bit
+    // atomically, so only the history and journal append is serialized, under logLock. They all hold
+    // compactionLock shared; compaction, which swaps the catalogue mapping, holds it exclusively.
+    // Adding items and the interactive menus are single-threaded.
+    mutex logLock;
+    shared_mutex compactionLock;
+
+    bool isAvailable(size_t index) const {
+        return availableBits.test(index);
+    }
+
+    string_view nameOf(size_t index) const {
+        return items[index] ? string_view(items[index]->getName()) : catalogue.name(index);
+    }
+
+    string_view descriptionOf(size_t index) const {
+        return items[index] ? string_view(items[index]->getDescription()) : catalogue.description(index);
+    }
+
+    double priceOf(size_t index) const {
+        return items[index] ? items[index]->getPrice() : catalogue.price(index);
+    }
+
+    // A copy for display or saving, with its current availability
+    Item itemCopy(size_t index) const {
+        Item copy = items[index] ? *items[index] : catalogue.item(index);
+        if (isAvailable(index)) copy.markAvailable();
+        else copy.markUnavailable();
+        return copy;
+    }
+
+    void indexName(size_t index) {
+        sameNameNext[index] = NO_ITEM;
+        sameNameLast[index] = index;
+        auto inserted = itemIndex.emplace(nameOf(index), index);
+        if (!inserted.second) {
+            size_t head = inserted.first->second;
+            sameNameNext[sameNameLast[head]] = index;
+            sameNameLast[head] = index;
+        }
+    }
+
+    void buildItemIndex() {
+        itemIndex.clear();
+        itemIndex.reserve(items.size());
+        sameNameNext.resize(items.size());
+        sameNameLast.resize(items.size());
+        for (size_t index = 0; index < items.size(); index++) {
+            indexName(index);
+        }
+        itemIndexBuilt = true;
+    }
+
+    // Add an item after the last one to the availability bitset, and to the name index once it exists
+    void insertItem(Item newItem) {
+        size_t index = items.size();
+        items.emplace_back(new Item(move(newItem)));
+        const Item& item = *items.back();
+        availableBits.resize(items.size());
+        availableBits.set(index, item.checkAvailability());
+        if (itemIndexBuilt) {
+            sameNameNext.push_back(NO_ITEM);
+            sameNameLast.push_back(index);
+            indexName(index);
+        }
+        if (searchIndexBuilt) searchIndex.add(item.getName(), item.getDescription(), item.getPrice());
+    }
+
+    // Track the catalogue's items from `first` on, which are only in the mapping
+    void mapCatalogueItems(size_t first) {
+        items.resize(catalogue.size());
+        availableBits.resize(items.size());
+        for (size_t index = first; index < items.size(); index++) {
+            if (catalogue.available(index)) availableBits.set(index, true);
+            if (searchIndexBuilt) searchIndex.add(nameOf(index), descriptionOf(index), priceOf(index));
+        }
+    }
+
+    void buildSearchIndex() {
+        for (size_t index = searchIndex.size(); index < items.size(); index++) {
+            searchIndex.add(nameOf(index), descriptionOf(index), priceOf(index));
+        }
+        searchIndex.finishBuild();
+        searchIndexBuilt = true;
+    }
+
+    bool hasBookings(size_t index) const {
+        return index / 64 < bookedBits.size() && (bookedBits[index / 64] >> (index % 64) & 1);
+    }
+
+    BookingCalendar& calendarOf(size_t index) {
+        if (hasBookings(index)) return *calendars[index];
+        if (calendars.size() <= index) calendars.resize(items.size());
+        if (bookedBits.size() <= index / 64) bookedBits.resize(index / 64 + 1, 0);
+        bookedBits[index / 64] |= uint64_t(1) << (index % 64);
+        calendars[index].reset(new BookingCalendar());
+        return *calendars[index];
+    }
+
+    // Not out on a reservation, and not booked at any time in [from, to)
+    bool isFree(size_t index, uint32_t from, uint32_t to) const {
+        return isAvailable(index) && (!hasBookings(index) || calendars[index]->isFree(from, to));
+    }
+
+    // False, changing nothing, if the item is already reserved or booked at `time`
+    bool applyReservation(size_t index, const string& userEmail, uint32_t time) {
+        if (!isAvailable(index) || (hasBookings(index) && calendars[index]->bookingAt(time) != calendars[index]->all().end())) {
+            return false;
+        }
+        calendarOf(index).hold(time, userEmail);
+        availableBits.set(index, false);
+        rentalHistory.record(userEmail, nameOf(index), time);
+        return true;
+    }
+
+    // False, changing nothing, if the item is not free from `from` to `to`
+    bool applyBooking(size_t index, const string& userEmail, uint32_t from, uint32_t to) {
+        if (!isFree(index, from, to) || !calendarOf(index).book(from, to, userEmail)) return false;
+        rentalHistory.record(userEmail, nameOf(index), from);
+        return true;
+    }
+
+    // `start` is when the reservation or booking being returned began
+    void applyReturn(size_t index, uint32_t start, uint32_t time) {
+        if (!hasBookings(index)) return;
+        BookingCalendar& calendar = *calendars[index];
+        if (calendar.release(start, time)) return;
+        // Only a reservation took the item out of browsing and reserving
+        if (calendar.heldBy().empty() || calendar.heldFrom() != start) return;
+        calendar.unhold();
+        availableBits.set(index, true);
+    }
+
+    // Drop the bookings over by `time`, and the calendars left empty
+    void pruneBookings(uint32_t time) {
+        for (size_t word = 0; word < bookedBits.size(); word++) {
+            for (uint64_t bits = bookedBits[word]; bits != 0; bits &= bits - 1) {
+                size_t index = word * 64 + lowestBit(bits);
+                calendars[index]->prune(time);
+                if (!calendars[index]->empty()) continue;
+                calendars[index].reset();
+                bookedBits[word] &= ~(uint64_t(1) << (index % 64));
+            }
+        }
+    }
+
+    bool compactionDue() const {
+        return journal.recordCount() >= max(MIN_COMPACTION_RECORDS, items.size() / 4);
+    }
+
+    void journalRecord(const string& line, Durability durability) {
+        if (!journal.append(line, durability)) cerr << "Failed to write the journal\n";
+        if (compactionDue()) compact();
+    }
+
+    // Apply the changes logged since the last snapshot; a torn last record is cut off
+    void replayJournal() {
+        ifstream file("rental_journal.txt", ios::binary);
+        string line;
+        size_t validLength = 0;
+        size_t replayed = 0;
+        size_t conflicts = 0;
+        while (getline(file, line)) {
+            if (file.eof()) break; // No newline: the write was cut short
+            validLength += line.size() + 1;
+            replayed++;
+            Item item("", "", 0, false);
+            if (line.compare(0, 2, "A,") == 0) {
+                if (Item::fromString(string_view(line).substr(2), item)) insertItem(move(item));
+            }
+            else if (line.compare(0, 2, "R,") == 0) {
+                // "R,<index>,<email>,<time>", or "R,<index>,<email>" from before times were kept
+                CsvField fields[4];
+                CsvField untimed[3];
+                uint64_t index, time = 0;
+                bool valid;
+                if (splitCsv(line, fields)) {
+                    valid = parseUnsigned(fields[3].text, time) && time <= UINT32_MAX;
+                }
+                else {
+                    valid = splitCsv(line, untimed);
+                    copy(begin(untimed), end(untimed), fields);
+                }
+                if (valid && parseUnsigned(fields[1].text, index) && index < items.size()
+                    && !applyReservation(index, fields[2].str(), static_cast<uint32_t>(time))) {
+                    conflicts++;
+                }
+            }
+            else if (line.compare(0, 2, "B,") == 0) {
+                // "B,<index>,<from>,<to>,<email>"
+                CsvField fields[5];
+                uint64_t index, from, to;
+                if (splitCsv(line, fields) && parseUnsigned(fields[1].text, index) && parseUnsigned(fields[2].text, from)
+                    && parseUnsigned(fields[3].text, to) && index < items.size()
+                    && !applyBooking(index, fields[4].str(), static_cast<uint32_t>(from), static_cast<uint32_t>(to))) {
+                    conflicts++;
+                }
+            }
+            else if (line.compare(0, 2, "T,") == 0) {
+                // "T,<index>,<booking start>,<time>"
+                CsvField fields[4];
+                uint64_t index, start, time;
+                if (splitCsv(line, fields) && parseUnsigned(fields[1].text, index) && parseUnsigned(fields[2].text, start)
+                    && parseUnsigned(fields[3].text, time) && index < items.size()) {
+                    applyReturn(index, static_cast<uint32_t>(start), static_cast<uint32_t>(time));
+                }
+            }
+            else if (line.compare(0, 2, "U,") == 0) {
+                // "U,<index>": an item out with no renter on record, released by an admin
+                uint64_t index;
+                if (parseUnsigned(string_view(line).substr(2), index) && index < items.size() && !releaseUnheld(index)) conflicts++;
+            }
+        }
+        file.close();
+        if (conflicts > 0) cerr << "Skipped " << conflicts << " journal records for items already reserved or booked\n";
+        if (validLength < fileSize("rental_journal.txt")) truncateFile("rental_journal.txt", validLength);
+        journal.setRecordCount(replayed);
+    }
+
+    static size_t fileSize(const string& filename) {
+        ifstream file(filename, ios::binary | ios::ate);
+        return file ? static_cast<size_t>(file.tellg()) : 0;
+    }
+
+    // Make an unavailable item available again if no renter holds it on record; false if it is not one
+    bool releaseUnheld(size_t index) {
+        if (isAvailable(index) || (hasBookings(index) && !calendars[index]->heldBy().empty())) return false;
+        availableBits.set(index, true);
+        return true;
+    }
+
+    // The first item with the given name, or NO_ITEM; the rest follow through sameNameNext.
+    // The name index must already be built.
+    size_t firstNamed(string_view itemName) const {
+        auto found = itemIndex.find(itemName);
+        return found == itemIndex.end() ? NO_ITEM : found->second;
+    }
+
+    // The return giveBack makes, under logLock; its journal record, or "" if there is nothing to return.
+    // Items reserved before bookings were kept have no holder on record, so they cannot be returned here.
+    string returnNamed(const string& userEmail, string_view itemName, uint32_t now) {
+        size_t returned = NO_ITEM;
+        uint32_t start = 0;
+        for (size_t index = firstNamed(itemName); index != NO_ITEM; index = sameNameNext[index]) {
+            if (!hasBookings(index)) continue;
+            const BookingCalendar& calendar = *calendars[index];
+            uint32_t from;
+            if (calendar.heldBy() == userEmail) {
+                from = calendar.heldFrom();
+            }
+            else {
+                auto booking = calendar.bookingAt(now);
+                if (booking != calendar.all().end() && booking->second.renter == userEmail) from = booking->first;
+                else if ((from = calendar.nextOf(userEmail, now)) == 0) continue; // Beyond any one in force
+            }
+            if (returned == NO_ITEM || from < start) {
+                returned = index;
+                start = from;
+            }
+        }
+        if (returned == NO_ITEM) return "";
+        applyReturn(returned, start, now);
+        return "T," + to_string(returned) + "," + to_string(start) + "," + to_string(now) + "\n";
+    }
+
+public:
+    // Parse items.txt on several threads, then add the items in order
+    void loadItems() {
+        MappedFile file;
+        if (!file.open("items.txt")) return;
+        size_t rejected, firstRejected;
+        vector<vector<Item>> chunks = parseLinesInParallel<vector<Item>>(string_view(file.data(), file.size()),
+            [](string_view line, vector<Item>& chunk) {
+                ItemFields fields;
+                if (!fields.parse(line)) return false;
+                chunk.emplace_back(fields.name.str(), fields.description.str(), fields.price, fields.available);
+                return true;
+            }, rejected, firstRejected);
+        for (vector<Item>& chunk : chunks) {
+            for (Item& item : chunk) {
+                insertItem(move(item));
+            }
+        }
+        if (rejected > 0) cerr << "Skipped " << rejected << " malformed line(s) in items.txt, the first at line " << firstRejected << "\n";
+    }
+
+    // Use items.bin in place: only the availability bits are read up front
+    bool loadBinaryItems() {
+        if (!catalogue.open("items.bin")) return false;
+        binaryCatalogue = true;
+        mapCatalogueItems(0);
+        return true;
+    }
+
+    bool saveItems(const string& filename = "items.txt") const {
+        return writeLinesInParallel(filename, items.size(), [this](size_t index, string& out) {
+            appendItemLine(out, nameOf(index), descriptionOf(index), priceOf(index), isAvailable(index));
+            out += '\n';
+        });
+    }
+
+    // Every item, followed by those in `imported` if given
+    bool saveBinaryItems(const string& filename = "items.bin", const vector<CatalogueBuilder>* imported = nullptr) const {
+        CatalogueBuilder builder;
+        for (size_t index = 0; index < items.size(); index++) {
+            builder.add(nameOf(index), descriptionOf(index), priceOf(index), isAvailable(index));
+        }
+        vector<const CatalogueBuilder*> parts = { &builder };
+        if (imported) {
+            for (const CatalogueBuilder& chunk : *imported) parts.push_back(&chunk);
+        }
+        return CatalogueBuilder::write(filename, parts);
+    }
+
+    void loadRentalHistory() {
+        rentalHistory.load("rental_history.txt");
+    }
+
+    bool saveRentalHistory(const string& filename = "rental_history.txt") {
+        return rentalHistory.save(filename);
+    }
+
+    // Lines are "<index>,<start>,<end>,<email>" with an empty end for a reservation
+    void loadBookings() {
+        ifstream file("bookings.txt");
+        string line;
+        CsvField fields[4];
+        while (getline(file, line)) {
+            uint64_t index, start, end = 0;
+            if (!splitCsv(line, fields) || !parseUnsigned(fields[0].text, index) || !parseUnsigned(fields[1].text, start)
+                || (!fields[2].text.empty() && !parseUnsigned(fields[2].text, end)) || index >= items.size()) {
+                continue;
+            }
+            if (fields[2].text.empty()) calendarOf(index).hold(static_cast<uint32_t>(start), fields[3].str());
+            else calendarOf(index).book(static_cast<uint32_t>(start), static_cast<uint32_t>(end), fields[3].str());
+        }
+    }
+
+    // The bookings not over by `time`; false if the file could not be written in full
+    bool saveBookings(const string& filename, uint32_t time) const {
+        ofstream file(filename);
+        string line;
+        for (size_t index = 0; index < calendars.size(); index++) {
+            if (!calendars[index]) continue;
+            const BookingCalendar& calendar = *calendars[index];
+            if (!calendar.heldBy().empty()) {
+                line = to_string(index) + "," + to_string(calendar.heldFrom()) + ",,";
+                appendCsvField(line, calendar.heldBy());
+                line += '\n';
+                file << line;
+            }
+            for (const auto& booking : calendar.all()) {
+                if (booking.second.end <= time) continue;
+                line = to_string(index) + "," + to_string(booking.first) + "," + to_string(booking.second.end) + ",";
+                appendCsvField(line, booking.second.renter);
+                line += '\n';
+                file << line;
+            }
+        }
+        file.close();
+        return !file.fail();
+    }
+
+    // Load the last snapshot (items.bin if present, else items.txt) and replay the journal on top of it,
+    // then keep logging to the journal
+    void load() {
+        finishCompaction({ "items.txt", "items.bin", "rental_history.txt", "bookings.txt" }, "compaction.ready", "rental_journal.txt");
+        if (fileExists("items.bin") && !loadBinaryItems()) {
+            cerr << "items.bin is not a valid catalogue; reading items.txt instead\n";
+        }
+        if (!binaryCatalogue) loadItems();
+        loadRentalHistory();
+        loadBookings();
+        replayJournal();
+        if (!journal.open("rental_journal.txt")) cerr << "Failed to open the journal; changes will not be saved\n";
+    }
+
+    // Write a snapshot with every change so far and empty the journal. With a binary catalogue, the
+    // items in `imported` are appended in the same snapshot.
+    bool compact(const vector<CatalogueBuilder>* imported = nullptr) {
+        journal.sync();
+        string itemsFile = binaryCatalogue ? "items.bin" : "items.txt";
+        string pendingItems = itemsFile + ".new";
+        bool written = binaryCatalogue ? saveBinaryItems(pendingItems, imported) : saveItems(pendingItems);
+        written = saveRentalHistory("rental_history.txt.new") && written;
+        uint32_t now = static_cast<uint32_t>(time(nullptr));
+        written = saveBookings("bookings.txt.new", now) && written;
+        syncFile(pendingItems);
+        syncFile("rental_history.txt.new");
+        syncFile("bookings.txt.new");
+        if (!written || !commitCompaction("compaction.ready")) {
+            cerr << "Failed to compact the journal\n";
+            return false;
+        }
+        bool rebuildItemIndex = binaryCatalogue && itemIndexBuilt;
+        if (binaryCatalogue) {
+            // The new catalogue holds every item at the same index, so unused items are mapped from it instead
+            catalogue.close();
+            itemIndexBuilt = false;
+        }
+        replaceFile(pendingItems, itemsFile);
+        replaceFile("rental_history.txt.new", "rental_history.txt");
+        replaceFile("bookings.txt.new", "bookings.txt");
+        pruneBookings(now);
+        if (binaryCatalogue && !catalogue.open(itemsFile)) {
+            cerr << "Failed to reopen " << itemsFile << "\n";
+        }
+        if (binaryCatalogue) mapCatalogueItems(items.size());
+        // Its keys pointed into the old mapping; rebuild it now so concurrent reservations never have to
+        if (rebuildItemIndex) buildItemIndex();
+        journal.clear();
+        remove("compaction.ready");
+        return true;
+    }
+
+    // Add many items with one snapshot instead of a journal record each. If the snapshot cannot be
+    // written, the items are journaled as addItem would, with one sync for them all.
+    bool importItems(const vector<CatalogueBuilder>& imported) {
+        if (binaryCatalogue) return compact(&imported);
+        size_t first = items.size();
+        for (const CatalogueBuilder& chunk : imported) {
+            for (size_t index = 0; index < chunk.size(); index++) {
+                insertItem(chunk.item(index));
+            }
+        }
+        if (compact()) return true;
+        if (first == items.size()) return false;
+        uint64_t sequence = 0;
+        for (size_t index = first; index < items.size(); index++) {
+            sequence = journal.queue("A," + items[index]->toString() + "\n");
+        }
+        if (sequence == 0 || !journal.waitFor(sequence)) {
+            cerr << "Failed to write the journal; the imported items are lost\n";
+            return false;
+        }
+        return true;
+    }
+
+    // Compact on exit only if anything was logged since the last snapshot
+    void compactIfChanged() {
+        if (journal.recordCount() > 0) compact();
+    }
+
+    void addItem(const Item& item) {
+        insertItem(item);
+        journalRecord("A," + item.toString() + "\n", additionDurability);
+    }
+
+    void browseItems() {
+        cout << "\nAvailable Items:\n";
+        for (size_t word = 0; word < availableBits.wordCount(); word++) {
+            for (uint64_t bits = availableBits.word(word); bits != 0; bits &= bits - 1) {
+                itemCopy(word * 64 + lowestBit(bits)).displayItem();
+            }
+        }
+        cout.flush();
+    }
+
+    void viewAllItems() {
+        cout << "\nAll Items in Inventory:\n";
+        for (size_t index = 0; index < items.size(); index++) {
+            itemCopy(index).displayItem();
+        }
+        cout.flush();
+    }
+
+    // The first `limit` items matching a query such as "available AND 'drill' AND price < 20"; `more` is
+    // set if there are others. False with `error` set if the query is invalid. Safe to call from several
+    // threads once prepareForServing has run.
+    bool findItems(const string& text, size_t limit, vector<Item>& found, bool& more, string& error) {
+        SearchQuery query;
+        if (!SearchQuery::parse(text, query, error)) return false;
+        if (!searchIndexBuilt) buildSearchIndex();
+        shared_lock<shared_mutex> serving(compactionLock);
+        SearchIndex::Result result = searchIndex.search(query, availableBits, limit);
+        found.clear();
+        for (uint32_t index : result.items) {
+            found.push_back(itemCopy(index));
+        }
+        more = result.more;
+        return true;
+    }
+
+    void searchItems(const string& text) {
+        const size_t MAX_SHOWN = 20;
+        vector<Item> found;
+        bool more;
+        string error;
+        if (!findItems(text, MAX_SHOWN, found, more, error)) {
+            cout << "Invalid search: " << error << "\n";
+            return;
+        }
+        if (found.empty()) cout << "\nNo matching items.\n";
+        else cout << "\nMatching items:\n";
+        for (const Item& item : found) {
+            item.displayItem();
+        }
+        if (more) cout << "Showing the first " << MAX_SHOWN << " matches; narrow the search to see others.\n";
+        cout.flush();
+    }
+
+    void setDurability(Durability reservations, Durability additions) {
+        reservationDurability = reservations;
+        additionDurability = additions;
+    }
+
+    // Build the indexes that are otherwise built on first use, before serving from several threads
+    void prepareForServing() {
+        if (!itemIndexBuilt) buildItemIndex();
+        if (!searchIndexBuilt) buildSearchIndex();
+    }
+
+    // Reserve the first available item with the given name from now until it is returned, and return its
+    // index, or NO_ITEM if none is left. An item booked by someone else right now is skipped; one booked
+    // later is not. Safe to call from several threads once prepareForServing has run.
+    size_t reserve(const string& userEmail, string_view itemName) {
+        bool due = false;
+        size_t index;
+        uint64_t sequence = 0;
+        {
+            shared_lock<shared_mutex> serving(compactionLock);
+            uint32_t now = static_cast<uint32_t>(time(nullptr));
+            for (index = firstNamed(itemName); index != NO_ITEM; index = sameNameNext[index]) {
+                // The bit goes to one caller; the calendar then says whether a booking is in force
+                if (!isAvailable(index) || !availableBits.claim(index)) continue;
+                lock_guard<mutex> logging(logLock);
+                if (!calendarOf(index).hold(now, userEmail)) {
+                    availableBits.set(index, true);
+                    continue;
+                }
+                rentalHistory.record(userEmail, nameOf(index), now);
+                string record = "R," + to_string(index) + ",";
+                appendCsvField(record, userEmail);
+                sequence = journal.queue(record + "," + to_string(now) + "\n");
+                due = compactionDue();
+                break;
+            }
+            if (index == NO_ITEM) return NO_ITEM;
+        }
+        if (due) {
+            unique_lock<shared_mutex> compacting(compactionLock);
+            if (compactionDue()) compact();
+        }
+        // Wait without any lock held, so the reservations queued meanwhile share this one's fsync
+        bool logged = sequence != 0 && (reservationDurability == Durability::Buffered || journal.waitFor(sequence));
+        if (!logged) cerr << "Failed to write the journal\n";
+        return index;
+    }
+
+    void reserveItem(const string& userEmail, const string& itemName) {
+        if (!itemIndexBuilt) buildItemIndex();
+        size_t index = reserve(userEmail, itemName);
+        if (index == NO_ITEM) {
+            cout << "Item not available or does not exist.\n";
+            return;
+        }
+        cout << "Item reserved successfully!\n";
+        uint32_t due = hasBookings(index) ? calendars[index]->nextStart(static_cast<uint32_t>(time(nullptr))) : 0;
+        if (due != 0) cout << "It is booked from " << formatRentalTime(due) << "; please return it before then.\n";
+    }
 
-// Ensure a file exists or create it if missing
-void ensureFileExists(const string& filename) {
-    ifstream file(filename);
-    if (!file) { // File does not exist
-        ofstream newFile(filename);
-        if (newFile) {
-            cout << "Created file: " << filename << endl;
+    // Book the first item with the given name that is free from `from` to `to`, and return its index,
+    // or NO_ITEM if every one is taken at some point in between
+    size_t book(const string& userEmail, string_view itemName, uint32_t from, uint32_t to) {
+        if (!itemIndexBuilt) buildItemIndex();
+        size_t index;
+        {
+            lock_guard<mutex> logging(logLock);
+            for (index = firstNamed(itemName); index != NO_ITEM && !isFree(index, from, to); index = sameNameNext[index]) {}
+            if (index == NO_ITEM) return NO_ITEM;
+            applyBooking(index, userEmail, from, to);
         }
-        else {
-            cerr << "Failed to create file: " << filename << endl;
+        string record = "B," + to_string(index) + "," + to_string(from) + "," + to_string(to) + ",";
+        appendCsvField(record, userEmail);
+        journalRecord(record + "\n", reservationDurability);
+        return index;
+    }
+
+    // End the renter's reservation of an item with this name, so it can be reserved again, or their
+    // booking in force now, or drop their next one; the one that started first if several. False if none.
+    bool giveBack(const string& userEmail, string_view itemName) {
+        if (!itemIndexBuilt) buildItemIndex();
+        uint32_t now = static_cast<uint32_t>(time(nullptr));
+        string record;
+        {
+            lock_guard<mutex> logging(logLock);
+            record = returnNamed(userEmail, itemName, now);
         }
+        if (record.empty()) return false;
+        journalRecord(record, reservationDurability);
+        return true;
     }
-}
 
-// Class for item
-class Item {
-    string name, description;
-    double rentalPrice;
-    bool isAvailable;
+    // Call visit(index) for each item free from `from` to `to`, in catalogue order, until it returns false.
+    // A word of the availability bits without bookedBits is 64 free items at once; only booked items
+    // need their calendar checked.
+    template <typename Visit>
+    void forEachFreeItem(uint32_t from, uint32_t to, Visit visit) const {
+        for (size_t word = 0; word < availableBits.wordCount(); word++) {
+            uint64_t free = availableBits.word(word);
+            uint64_t booked = word < bookedBits.size() ? free & bookedBits[word] : 0;
+            for (; booked != 0; booked &= booked - 1) {
+                int bit = lowestBit(booked);
+                if (!calendars[word * 64 + bit]->isFree(from, to)) free &= ~(uint64_t(1) << bit);
+            }
+            for (; free != 0; free &= free - 1) {
+                if (!visit(word * 64 + lowestBit(free))) return;
+            }
+        }
+    }
 
-public:
-    Item(string name, string description, double rentalPrice, bool isAvailable)
-        : name(name), description(description), rentalPrice(rentalPrice), isAvailable(isAvailable) {}
+    // Bookings are whole days, from the morning of `firstDay` to the end of `lastDay`
+    void bookItem(const string& userEmail, const string& itemName, uint32_t firstDay, uint32_t lastDay) {
+        uint32_t end;
+        if (!dayAfter(lastDay, end) || end <= firstDay) {
+            cout << "The last day cannot be before the first.\n";
+            return;
+        }
+        if (end <= time(nullptr)) {
+            cout << "Those days are already over.\n";
+            return;
+        }
+        if (book(userEmail, itemName, firstDay, end) == NO_ITEM) {
+            cout << "No " << itemName << " is free on those days.\n";
+            return;
+        }
+        cout << "Item booked from " << formatRentalTime(firstDay) << " to " << formatRentalTime(end) << ".\n";
+    }
 
-    string getName() { return name; }
-    double getPrice() { return rentalPrice; }
-    bool checkAvailability() { return isAvailable; }
+    void returnItem(const string& userEmail, const string& itemName) {
+        if (giveBack(userEmail, itemName)) cout << "Item returned.\n";
+        else cout << "You have no booking of " << itemName << ".\n";
+    }
 
-    void markUnavailable() { isAvailable = false; }
-    void markAvailable() { isAvailable = true; }
+    // Items reserved before bookings were kept are unavailable with no renter on record, so no renter can
+    // return them; an admin releases the first such item with this name. False if there is none.
+    bool release(string_view itemName) {
+        if (!itemIndexBuilt) buildItemIndex();
+        size_t index;
+        {
+            lock_guard<mutex> logging(logLock);
+            for (index = firstNamed(itemName); index != NO_ITEM && !releaseUnheld(index); index = sameNameNext[index]) {}
+            if (index == NO_ITEM) return false;
+        }
+        journalRecord("U," + to_string(index) + "\n", reservationDurability);
+        return true;
+    }
 
-    void displayItem() {
-        cout << "Name: " << name << ", Description: " << description
-            << ", Price: $" << rentalPrice << ", Available: " << (isAvailable ? "Yes" : "No") << endl;
+    void releaseItem(const string& itemName) {
+        if (release(itemName)) cout << "Item released.\n";
+        else cout << "No " << itemName << " is out without a renter on record.\n";
+    }
+
+    void showFreeItems(uint32_t firstDay, uint32_t lastDay) {
+        const size_t MAX_SHOWN = 20;
+        uint32_t end;
+        if (!dayAfter(lastDay, end) || end <= firstDay) {
+            cout << "The last day cannot be before the first.\n";
+            return;
+        }
+        size_t found = 0;
+        cout << "\nItems free from " << formatRentalTime(firstDay) << " to " << formatRentalTime(end) << ":\n";
+        forEachFreeItem(firstDay, end, [&](size_t index) {
+            if (found++ < MAX_SHOWN) itemCopy(index).displayItem();
+            return true;
+        });
+        if (found == 0) cout << "None.\n";
+        if (found > MAX_SHOWN) cout << "...and " << found - MAX_SHOWN << " more.\n";
+        cout.flush();
     }
 
-    string toString() {
-        return name + "," + description + "," + to_string(rentalPrice) + "," + (isAvailable ? "1" : "0");
+    // Page through a user's rentals from the last `days` days (all of them for 0), newest first
+    void viewRentalHistory(const string& userEmail, int days) {
+        const size_t PAGE_SIZE = 10;
+        uint32_t from = days > 0 ? static_cast<uint32_t>(max<int64_t>(time(nullptr) - int64_t(days) * 86400, 1)) : 0;
+        cout << "\nRental History for " << userEmail << ":\n";
+        for (size_t offset = 0;; offset += PAGE_SIZE) {
+            vector<RentalHistory::Rental> page = rentalHistory.query(userEmail, from, UINT32_MAX, offset, PAGE_SIZE + 1);
+            if (page.empty() && offset == 0) cout << "No rentals.\n";
+            for (size_t i = 0; i < min(page.size(), PAGE_SIZE); i++) {
+                cout << page[i].item << " (" << formatRentalTime(page[i].time) << ")\n";
+            }
+            if (page.size() <= PAGE_SIZE) break;
+            char more;
+            cout << "Show more? (y/n): ";
+            cin >> more;
+            if (tolower(more) != 'y') break;
+        }
     }
 
-    static Item fromString(string data) {
-        stringstream ss(data);
-        string name, description, rentalPriceStr, availabilityStr;
-        getline(ss, name, ',');
-        getline(ss, description, ',');
-        getline(ss, rentalPriceStr, ',');
-        getline(ss, availabilityStr, ',');
-        double rentalPrice = stod(rentalPriceStr);
-        bool isAvailable = (availabilityStr == "1");
-        return Item(name, description, rentalPrice, isAvailable);
+    void viewPopularItems() {
+        const size_t TOP_ITEMS = 10;
+        cout << "\nMost Rented Items (" << rentalHistory.size() << " rentals):\n";
+        for (auto& entry : rentalHistory.mostPopular(TOP_ITEMS)) {
+            cout << entry.first << ": " << entry.second << "\n";
+        }
     }
 };
 
-// Base Class: User
-class User {
-protected:
-    string name, email, password, role;
+// Append-only character storage in large blocks; views into it stay valid until the arena goes away
+class StringArena {
+    static const size_t BLOCK_SIZE = 1 << 20;
+
+    vector<unique_ptr<char[]>> blocks;
+    size_t used = BLOCK_SIZE; // Bytes taken in the last block
 
 public:
-    User(string name, string email, string password, string role)
-        : name(name), email(email), password(password), role(role) {}
+    string_view store(string_view text) {
+        if (text.size() > BLOCK_SIZE / 4) {
+            // Large strings get a block of their own, placed before the block still being filled
+            unique_ptr<char[]> own(new char[text.size()]);
+            memcpy(own.get(), text.data(), text.size());
+            string_view stored(own.get(), text.size());
+            blocks.insert(blocks.empty() ? blocks.end() : blocks.end() - 1, move(own));
+            return stored;
+        }
+        if (used + text.size() > BLOCK_SIZE) {
+            blocks.emplace_back(new char[BLOCK_SIZE]);
+            used = 0;
+        }
+        char* start = blocks.back().get() + used;
+        memcpy(start, text.data(), text.size());
+        used += text.size();
+        return string_view(start, text.size());
+    }
+};
 
-    string getEmail() { return email; }
-    string getPassword() { return password; }
-    string getRole() { return role; }
+// Fixed-size slots for Admin and Renter objects, handed out from blocks of BLOCK_SLOTS that never move,
+// so User pointers stay valid; destroyed users' slots are reused
+class UserPool {
+    static const size_t BLOCK_SLOTS = 4096;
 
-    virtual void displayMenu(class RentalManager& rentalManager) = 0; // Pure virtual function
+    struct Slot {
+        alignas(Admin) alignas(Renter) unsigned char bytes[sizeof(Admin) > sizeof(Renter) ? sizeof(Admin) : sizeof(Renter)];
+    };
 
-    virtual string toString() {
-        return name + "," + email + "," + password + "," + role;
-    }
+    vector<unique_ptr<Slot[]>> blocks;
+    size_t used = BLOCK_SLOTS; // Slots taken in the last block
+    vector<void*> freeSlots;
 
-    static User* fromString(string data);
-};
+    void* allocate() {
+        if (!freeSlots.empty()) {
+            void* slot = freeSlots.back();
+            freeSlots.pop_back();
+            return slot;
+        }
+        if (used == BLOCK_SLOTS) {
+            blocks.emplace_back(new Slot[BLOCK_SLOTS]);
+            used = 0;
+        }
+        return &blocks.back()[used++];
+    }
 
-// Derived Class: Admin
-class Admin : public User {
 public:
-    Admin(string name, string email, string password)
-        : User(name, email, password, "Admin") {}
+    template <typename T>
+    User* create(string_view name, string_view email, string_view password) {
+        static_assert(sizeof(T) <= sizeof(Slot), "every user type must fit a slot");
+        return new (allocate()) T(name, email, password);
+    }
 
-    void displayMenu(class RentalManager& rentalManager) override;
+    void destroy(User* user) {
+        void* slot = dynamic_cast<void*>(user); // Start of the Admin or Renter object
+        user->~User();
+        freeSlots.push_back(slot);
+    }
 };
 
-// Derived Class Renter
-class Renter : public User {
-public:
-    Renter(string name, string email, string password)
-        : User(name, email, password, "Renter") {}
+// UserManager Class: the process-wide user store, loaded once from users.txt and its journal.
+// Users are built in a pool and their strings kept in one arena, so loading allocates in large blocks
+// rather than once per user and string. Strings of edited or deleted users stay in the arena until exit.
+class UserManager {
+    StringArena strings;
+    UserPool pool;
+    vector<User*> users;
+    unordered_map<string_view, User*> usersByEmail;
 
-    void displayMenu(class RentalManager& rentalManager) override;
-};
+    // Added, edited and deleted users are logged to users_journal.txt instead of rewriting users.txt,
+    // which is compacted the same way as the rental snapshots
+    static constexpr size_t MIN_COMPACTION_RECORDS = 1024;
+    Journal journal;
+    // Changes are rare and made by hand, so each one is on disk before it is confirmed
+    static constexpr Durability CHANGE_DURABILITY = Durability::Synced;
+
+    UserManager() {
+        finishCompaction({ "users.txt" }, "users_compaction.ready", "users_journal.txt");
+        loadUsers();
+        replayJournal();
+        if (!journal.open("users_journal.txt")) cerr << "Failed to open the user journal; changes will not be saved\n";
+    }
+
+    ~UserManager() {
+        for (User* user : users) {
+            pool.destroy(user);
+        }
+    }
 
-User* User::fromString(string data) {
-    stringstream ss(data);
-    string name, email, password, role;
-    getline(ss, name, ',');
-    getline(ss, email, ',');
-    getline(ss, password, ',');
-    getline(ss, role, ',');
+    // A new user with copies of the given strings, or nullptr for an unknown role
+    User* createUser(string_view role, string_view name, string_view email, string_view password) {
+        if (role != "Admin" && role != "Renter") return nullptr;
+        name = strings.store(name);
+        email = strings.store(email);
+        password = strings.store(password);
+        return role == "Admin" ? pool.create<Admin>(name, email, password) : pool.create<Renter>(name, email, password);
+    }
 
-    if (role == "Admin") {
-        return new Admin(name, email, password);
+    // A new user from "name,email,password,role" fields, or nullptr for an unknown role
+    User* createUser(const CsvField (&fields)[4]) {
+        string name = fields[0].str(), email = fields[1].str(), password = fields[2].str();
+        return createUser(fields[3].text, name, email, password);
     }
-    else if (role == "Renter") {
-        return new Renter(name, email, password);
+
+    // A new user from a "name,email,password,role" line, or nullptr if it is not valid
+    User* createUser(string_view line) {
+        CsvField fields[4];
+        if (!splitCsv(line, fields)) return nullptr;
+        return createUser(fields);
     }
-    return nullptr;
-}
 
-// RentalManager Class
-class RentalManager {
-    vector<Item> items;
-    map<string, vector<string>> rentalHistory;
+    User* findUser(string_view email) const {
+        auto found = usersByEmail.find(email);
+        return found == usersByEmail.end() ? nullptr : found->second;
+    }
 
-public:
-    void loadItems() {
-        ifstream file("items.txt");
-        string line;
-        while (getline(file, line)) {
-            items.push_back(Item::fromString(line));
+    size_t positionOf(const User* user) const {
+        return find(users.begin(), users.end(), user) - users.begin();
+    }
+
+    // Take ownership of a user; false (destroying it) if the email is already registered
+    bool insertUser(User* user) {
+        if (!user) return false;
+        if (!usersByEmail.emplace(user->getEmail(), user).second) {
+            pool.destroy(user);
+            return false;
         }
-        file.close();
+        users.push_back(user);
+        return true;
     }
 
-    void saveItems() {
-        ofstream file("items.txt");
-        for (auto& item : items) {
-            file << item.toString() << endl;
+    // Put a new user in the place of the one at `position`; false (destroying it) if its email belongs to someone else
+    bool replaceUser(size_t position, User* user) {
+        User* old = users[position];
+        User* owner = findUser(user->getEmail());
+        if (owner && owner != old) {
+            pool.destroy(user);
+            return false;
         }
-        file.close();
+        usersByEmail.erase(old->getEmail());
+        usersByEmail[user->getEmail()] = user;
+        users[position] = user;
+        pool.destroy(old);
+        return true;
     }
 
-    void loadRentalHistory() {
-        ifstream file("rental_history.txt");
+    void removeUser(size_t position) {
+        usersByEmail.erase(users[position]->getEmail());
+        pool.destroy(users[position]);
+        users.erase(users.begin() + position);
+    }
+
+    void journalRecord(const string& line) {
+        if (!journal.append(line, CHANGE_DURABILITY)) cerr << "Failed to write the user journal\n";
+        if (journal.recordCount() >= max(MIN_COMPACTION_RECORDS, users.size() / 4)) compact();
+    }
+
+    // Records are "A,<user>", "E,<old email>,<user>" and "D,<email>"; a torn last record is cut off
+    void replayJournal() {
+        ifstream file("users_journal.txt", ios::binary);
         string line;
+        size_t validLength = 0;
+        size_t replayed = 0;
         while (getline(file, line)) {
-            stringstream ss(line);
-            string email, item;
-            getline(ss, email, ':');
-            while (getline(ss, item, ',')) {
-                rentalHistory[email].push_back(item);
+            if (file.eof()) break; // No newline: the write was cut short
+            validLength += line.size() + 1;
+            replayed++;
+            string_view record(line);
+            if (record.compare(0, 2, "A,") == 0) {
+                insertUser(createUser(record.substr(2)));
             }
-        }
-        file.close();
-    }
-
-    void saveRentalHistory() {
-        ofstream file("rental_history.txt");
-        for (auto& entry : rentalHistory) {
-            file << entry.first << ":";
-            for (auto& item : entry.second) {
-                file << item << ",";
+            else if (record.compare(0, 2, "E,") == 0) {
+                CsvField fields[5];
+                User* old = splitCsv(record.substr(2), fields) ? findUser(fields[0].str()) : nullptr;
+                User* user = old ? createUser({ fields[1], fields[2], fields[3], fields[4] }) : nullptr;
+                if (user) replaceUser(positionOf(old), user);
+            }
+            else if (record.compare(0, 2, "D,") == 0) {
+                User* user = findUser(record.substr(2));
+                if (user) removeUser(positionOf(user));
             }
-            file << endl;
         }
         file.close();
+        ifstream sized("users_journal.txt", ios::binary | ios::ate);
+        if (sized && validLength < static_cast<size_t>(sized.tellg())) truncateFile("users_journal.txt", validLength);
+        journal.setRecordCount(replayed);
     }
 
-    void addItem(Item item) {
-        items.push_back(item);
+public:
+    UserManager(const UserManager&) = delete;
+    UserManager& operator=(const UserManager&) = delete;
+
+    // The one store shared by the main menu and every admin session
+    static UserManager& instance() {
+        static UserManager store;
+        return store;
     }
 
-    void browseItems() {
-        cout << "\nAvailable Items:\n";
-        for (auto& item : items) {
-            if (item.checkAvailability()) {
-                item.displayItem();
+    // Split the lines of a users file on several threads into views of its fields, then add the users in
+    // order; `rejected` counts malformed lines and users whose email is already taken
+    size_t insertUsersFrom(const string& filename, size_t& rejected, size_t& firstRejected) {
+        MappedFile file;
+        rejected = firstRejected = 0;
+        if (!file.open(filename)) return 0;
+        struct Fields {
+            CsvField field[4];
+        };
+        vector<vector<Fields>> chunks = parseLinesInParallel<vector<Fields>>(string_view(file.data(), file.size()),
+            [](string_view line, vector<Fields>& chunk) {
+                Fields fields;
+                if (!splitCsv(line, fields.field) || (fields.field[3].text != "Admin" && fields.field[3].text != "Renter")) return false;
+                chunk.push_back(fields);
+                return true;
+            }, rejected, firstRejected);
+        size_t inserted = 0;
+        for (const vector<Fields>& chunk : chunks) {
+            for (const Fields& fields : chunk) {
+                if (insertUser(createUser(fields.field))) inserted++;
+                else rejected++;
             }
         }
+        return inserted;
     }
 
-    void viewAllItems() {
-        cout << "\nAll Items in Inventory:\n";
-        for (auto& item : items) {
-            item.displayItem();
-        }
+    void loadUsers() {
+        size_t rejected, firstRejected;
+        insertUsersFrom("users.txt", rejected, firstRejected);
+        if (firstRejected > 0) cerr << "Skipped malformed line(s) in users.txt, the first at line " << firstRejected << "\n";
     }
 
-    void reserveItem(string userEmail, string itemName) {
-        for (auto& item : items) {
-            if (item.getName() == itemName && item.checkAvailability()) {
-                item.markUnavailable();
-                rentalHistory[userEmail].push_back(itemName);
-                cout << "Item reserved successfully!\n";
-                saveItems();
-                saveRentalHistory();
-                return;
-            }
-        }
-        cout << "Item not available or does not exist.\n";
+    bool saveUsers(const string& filename = "users.txt") const {
+        return writeLinesInParallel(filename, users.size(), [this](size_t index, string& out) {
+            out += users[index]->toString();
+            out += '\n';
+        });
     }
 
-    void viewRentalHistory(string userEmail) {
-        cout << "\nRental History for " << userEmail << ":\n";
-        for (auto& item : rentalHistory[userEmail]) {
-            cout << item << endl;
-        }
+    // Add the users in a file with one snapshot instead of a journal record each; false if the file
+    // cannot be read or the snapshot cannot be written
+    bool importUsers(const string& filename, size_t& imported, size_t& rejected, size_t& firstRejected) {
+        if (!fileExists(filename)) return false;
+        imported = insertUsersFrom(filename, rejected, firstRejected);
+        return imported == 0 || compact();
     }
-};
-
-// UserManager Class
-class UserManager {
-    vector<User*> users;
 
-public:
-    void loadUsers() {
-        ifstream file("users.txt");
-        string line;
-        while (getline(file, line)) {
-            users.push_back(User::fromString(line));
+    // Write users.txt with every change so far and empty the journal
+    bool compact() {
+        journal.sync();
+        bool written = saveUsers("users.txt.new");
+        syncFile("users.txt.new");
+        if (!written || !commitCompaction("users_compaction.ready")) {
+            cerr << "Failed to compact the user journal\n";
+            return false;
         }
-        file.close();
+        replaceFile("users.txt.new", "users.txt");
+        journal.clear();
+        remove("users_compaction.ready");
+        return true;
     }
 
-    void saveUsers() {
-        ofstream file("users.txt");
-        for (auto& user : users) {
-            file << user->toString() << endl;
-        }
-        file.close();
+    void compactIfChanged() {
+        if (journal.recordCount() > 0) compact();
     }
 
-    User* authenticate(string email, string password) {
-        for (auto& user : users) {
-            if (user->getEmail() == email && user->getPassword() == password) {
-                return user;
-            }
-        }
-        return nullptr;
+    bool isRenter(string_view email) const {
+        User* user = findUser(email);
+        return user && strcmp(user->getRole(), "Renter") == 0;
     }
 
-    void addUser(User* user) {
-        users.push_back(user);
-        saveUsers();
+    User* authenticate(string_view email, string_view password) {
+        User* user = findUser(email);
+        return user && user->getPassword() == password ? user : nullptr;
+    }
+
+    bool addUser(User* user) {
+        if (!user) return false;
+        string record = "A," + user->toString() + "\n";
+        if (!insertUser(user)) {
+            cout << "Email already registered. Registration failed.\n";
+            return false;
+        }
+        journalRecord(record);
+        return true;
     }
 
     void registerUser() {
@@ -260,11 +2589,9 @@ public:
         cout << "Role (Admin/Renter): ";
         getline(cin, role);
 
-        if (role == "Admin") {
-            addUser(new Admin(name, email, password));
-        }
-        else if (role == "Renter") {
-            addUser(new Renter(name, email, password));
+        User* user = createUser(role, name, email, password);
+        if (user) {
+            addUser(user);
         }
         else {
             cout << "Invalid role. Registration failed.\n";
@@ -274,14 +2601,15 @@ public:
     void displayUsers() {
         cout << "\nRegistered Users:\n";
         for (size_t i = 0; i < users.size(); ++i) {
-            cout << i + 1 << ". " << users[i]->toString() << endl;
+            cout << i + 1 << ". " << users[i]->toString() << "\n";
         }
+        cout.flush();
     }
 
     void editUser() {
         displayUsers();
         cout << "Enter the number of the user to edit: ";
-        int index;
+        size_t index;
         cin >> index;
         if (index > 0 && index <= users.size()) {
             string name, email, password, role;
@@ -295,18 +2623,19 @@ public:
             cout << "Enter New Role (Admin/Renter): ";
             getline(cin, role);
 
-            delete users[index - 1];
-            if (role == "Admin") {
-                users[index - 1] = new Admin(name, email, password);
-            }
-            else if (role == "Renter") {
-                users[index - 1] = new Renter(name, email, password);
-            }
-            else {
+            User* user = createUser(role, name, email, password);
+            if (!user) {
                 cout << "Invalid role. Edit failed.\n";
                 return;
             }
-            saveUsers();
+            string record = "E,";
+            appendCsvField(record, users[index - 1]->getEmail());
+            record += "," + user->toString() + "\n";
+            if (!replaceUser(index - 1, user)) {
+                cout << "Email already registered. Edit failed.\n";
+                return;
+            }
+            journalRecord(record);
             cout << "User updated successfully.\n";
         }
         else {
@@ -317,12 +2646,13 @@ public:
     void deleteUser() {
         displayUsers();
         cout << "Enter the number of the user to delete: ";
-        int index;
+        size_t index;
         cin >> index;
         if (index > 0 && index <= users.size()) {
-            delete users[index - 1];
-            users.erase(users.begin() + index - 1);
-            saveUsers();
+            // Removed before logging, so a compaction the record sets off no longer saves the user
+            string email(users[index - 1]->getEmail());
+            removeUser(index - 1);
+            journalRecord("D," + email + "\n");
             cout << "User deleted successfully.\n";
         }
         else {
@@ -333,8 +2663,7 @@ public:
 
 // Implementation of Admin::displayMenu
 void Admin::displayMenu(RentalManager& rentalManager) {
-    UserManager userManager;
-    userManager.loadUsers();
+    UserManager& userManager = UserManager::instance();
 
     int choice;
     while (true) {
@@ -342,7 +2671,9 @@ void Admin::displayMenu(RentalManager& rentalManager) {
         cout << "1. Add Item\n";
         cout << "2. View All Items\n";
         cout << "3. Manage Users\n";
-        cout << "4. Exit to Main Menu\n";
+        cout << "4. Most Rented Items\n";
+        cout << "5. Release Item Reserved Before Bookings\n";
+        cout << "6. Exit to Main Menu\n";
         cout << "Choose an option: ";
         cin >> choice;
 
@@ -358,13 +2689,12 @@ void Admin::displayMenu(RentalManager& rentalManager) {
                 cout << "Enter item description: ";
                 getline(cin, description);
                 cout << "Enter rental price: ";
-                while (!(cin >> price)) {
+                while (!(cin >> price) || !isfinite(price) || price < 0) {
                     cin.clear();
                     cin.ignore(numeric_limits<streamsize>::max(), '\n');
-                    cout << "Invalid price. Enter a numeric value: ";
+                    cout << "Invalid price. Enter a number of at least 0: ";
                 }
                 rentalManager.addItem(Item(name, description, price, true));
-                rentalManager.saveItems();
                 cout << "Item added successfully.\n";
                 cout << "Do you want to add another item? (y/n): ";
                 cin >> addAnother;
@@ -409,6 +2739,17 @@ void Admin::displayMenu(RentalManager& rentalManager) {
             break;
         }
         case 4:
+            rentalManager.viewPopularItems();
+            break;
+        case 5: {
+            string name;
+            cout << "Enter item name: ";
+            cin.ignore();
+            getline(cin, name);
+            rentalManager.releaseItem(name);
+            break;
+        }
+        case 6:
             return;
         default:
             cout << "Invalid choice. Try again.\n";
@@ -424,7 +2765,11 @@ void Renter::displayMenu(RentalManager& rentalManager) {
         cout << "1. Browse Items\n";
         cout << "2. Reserve Item\n";
         cout << "3. View Rental History\n";
-        cout << "4. Exit to Main Menu\n";
+        cout << "4. Search Items\n";
+        cout << "5. Book Item for Dates\n";
+        cout << "6. Return Item\n";
+        cout << "7. Items Free on Dates\n";
+        cout << "8. Exit to Main Menu\n";
         cout << "Choose an option: ";
         cin >> choice;
 
@@ -436,13 +2781,52 @@ void Renter::displayMenu(RentalManager& rentalManager) {
             string itemName;
             cout << "Enter item name to reserve: ";
             cin >> itemName;
-            rentalManager.reserveItem(email, itemName);
+            rentalManager.reserveItem(string(email), itemName);
             break;
         }
-        case 3:
-            rentalManager.viewRentalHistory(email);
+        case 3: {
+            int days;
+            cout << "Show rentals from the last how many days (0 for all)? ";
+            cin >> days;
+            rentalManager.viewRentalHistory(string(email), days);
             break;
-        case 4:
+        }
+        case 4: {
+            string query;
+            cout << "Search (e.g. available AND 'drill' AND price < 20): ";
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            getline(cin, query);
+            rentalManager.searchItems(query);
+            break;
+        }
+        case 5:
+        case 7: {
+            string itemName, first, last;
+            uint32_t firstDay, lastDay;
+            if (choice == 5) {
+                cout << "Enter item name to book: ";
+                cin >> itemName;
+            }
+            cout << "First day (YYYY-MM-DD): ";
+            cin >> first;
+            cout << "Last day (YYYY-MM-DD): ";
+            cin >> last;
+            if (!parseDate(first, firstDay) || !parseDate(last, lastDay)) {
+                cout << "Invalid date.\n";
+                break;
+            }
+            if (choice == 5) rentalManager.bookItem(string(email), itemName, firstDay, lastDay);
+            else rentalManager.showFreeItems(firstDay, lastDay);
+            break;
+        }
+        case 6: {
+            string itemName;
+            cout << "Enter item name to return: ";
+            cin >> itemName;
+            rentalManager.returnItem(string(email), itemName);
+            break;
+        }
+        case 8:
             return;
         default:
             cout << "Invalid choice. Try again.\n";
@@ -450,18 +2834,450 @@ void Renter::displayMenu(RentalManager& rentalManager) {
     }
 }
 
+// Convert a CSV catalogue to the binary format or back; returns the exit code
+int convertCatalogue(const string& mode, const string& from, const string& to) {
+    if (mode == "--to-binary") {
+        vector<CatalogueBuilder> items;
+        size_t rejected, firstRejected;
+        if (!readItemsCsv(from, items, rejected, firstRejected)) {
+            cerr << "Cannot read " << from << endl;
+            return 1;
+        }
+        if (rejected > 0) cerr << "Skipped " << rejected << " malformed line(s), the first at line " << firstRejected << endl;
+        vector<const CatalogueBuilder*> parts;
+        for (const CatalogueBuilder& chunk : items) parts.push_back(&chunk);
+        if (!CatalogueBuilder::write(to, parts)) {
+            cerr << "Cannot write " << to << endl;
+            return 1;
+        }
+        cout << "Wrote " << totalItems(items) << " items to " << to << ".\n";
+        return 0;
+    }
+
+    Catalogue catalogue;
+    if (!catalogue.open(from)) {
+        cerr << from << " is missing or is not a valid catalogue" << endl;
+        return 1;
+    }
+    if (!writeLinesInParallel(to, catalogue.size(), [&](size_t index, string& out) {
+        out += catalogue.item(index).toString();
+        out += '\n';
+    })) {
+        cerr << "Cannot write " << to << endl;
+        return 1;
+    }
+    cout << "Wrote " << catalogue.size() << " items to " << to << ".\n";
+    return 0;
+}
+
+// Add the items or users in a CSV file to the stores in the current directory, or write the stores out
+// as CSV; returns the exit code
+int bulkTransfer(const string& mode, const string& path) {
+    auto started = chrono::steady_clock::now();
+    auto elapsed = [&] { return chrono::duration<double>(chrono::steady_clock::now() - started).count(); };
+    ensureFileExists("users.txt");
+    ensureFileExists("items.txt");
+    ensureFileExists("rental_history.txt");
+
+    if (mode == "--import-users" || mode == "--export-users") {
+        UserManager& userManager = UserManager::instance();
+        if (mode == "--export-users") {
+            if (!userManager.saveUsers(path)) {
+                cerr << "Cannot write " << path << endl;
+                return 1;
+            }
+            cout << "Exported users to " << path << " in " << elapsed() << " s.\n";
+            return 0;
+        }
+        size_t imported = 0, rejected = 0, firstRejected = 0;
+        if (!userManager.importUsers(path, imported, rejected, firstRejected)) {
+            cerr << "Cannot import " << path << endl;
+            return 1;
+        }
+        cout << "Imported " << imported << " users in " << elapsed() << " s";
+        if (rejected > 0) cout << "; rejected " << rejected << " (malformed lines, the first at line " << firstRejected << ", or emails already registered)";
+        cout << ".\n";
+        return 0;
+    }
+
+    RentalManager rentalManager;
+    rentalManager.load();
+    if (mode == "--export-items") {
+        if (!rentalManager.saveItems(path)) {
+            cerr << "Cannot write " << path << endl;
+            return 1;
+        }
+        cout << "Exported items to " << path << " in " << elapsed() << " s.\n";
+        return 0;
+    }
+    vector<CatalogueBuilder> items;
+    size_t rejected, firstRejected;
+    if (!readItemsCsv(path, items, rejected, firstRejected)) {
+        cerr << "Cannot read " << path << endl;
+        return 1;
+    }
+    if (!rentalManager.importItems(items)) return 1;
+    cout << "Imported " << totalItems(items) << " items in " << elapsed() << " s";
+    if (rejected > 0) cout << "; skipped " << rejected << " malformed line(s), the first at line " << firstRejected;
+    cout << ".\n";
+    return 0;
+}
+
+#ifndef _WIN32
+// Serves many renters at once from one RentalManager over a Unix domain socket. Each connection gets
+// its own thread and speaks a line protocol:
+//   RESERVE <email> <item name>   ->  OK <index> | UNAVAILABLE | ERROR <reason>
+//   SEARCH <query>                ->  an "ITEM <name>,<description>,<price>,<available>" line per match,
+//                                     then END, or MORE if there are further matches
+//   QUIT
+// The email must belong to a registered renter. Users are not changed while serving.
+class ReservationServer {
+    static const size_t MAX_SEARCH_RESULTS = 50;
+
+    RentalManager& rentalManager;
+    string path;
+    int listener = -1;
+    atomic<bool> stopping{ false };
+    thread acceptor;
+
+    mutex clientsLock;
+    condition_variable clientsDone;
+    vector<int> clientSockets; // Open connections, shut down by stop()
+
+    static bool sendAll(int fd, const string& text) {
+        size_t sent = 0;
+        while (sent < text.size()) {
+            ssize_t written = send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) return false;
+            sent += static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    string handle(const string& line) {
+        if (line.compare(0, 8, "RESERVE ") == 0) {
+            size_t space = line.find(' ', 8);
+            string email = line.substr(8, space == string::npos ? string::npos : space - 8);
+            if (space == string::npos || space + 1 == line.size()) return "ERROR usage: RESERVE <email> <item name>\n";
+            if (!UserManager::instance().isRenter(email)) return "ERROR " + email + " is not a registered renter\n";
+            size_t index = rentalManager.reserve(email, string_view(line).substr(space + 1));
+            return index == NO_ITEM ? "UNAVAILABLE\n" : "OK " + to_string(index) + "\n";
+        }
+        if (line.compare(0, 7, "SEARCH ") == 0) {
+            vector<Item> found;
+            bool more;
+            string error;
+            if (!rentalManager.findItems(line.substr(7), MAX_SEARCH_RESULTS, found, more, error)) return "ERROR " + error + "\n";
+            string reply;
+            for (const Item& item : found) {
+                reply += "ITEM " + item.toString() + "\n";
+            }
+            return reply + (more ? "MORE\n" : "END\n");
+        }
+        return "ERROR unknown command\n";
+    }
+
+    // One connection; replies to every complete line received so far with a single send
+    void serve(int fd) {
+        string pending;
+        char buffer[4096];
+        bool open = true;
+        while (open) {
+            ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+            if (received < 0 && errno == EINTR) continue;
+            if (received <= 0) break;
+            pending.append(buffer, static_cast<size_t>(received));
+            string replies;
+            size_t start = 0;
+            for (size_t newline; open && (newline = pending.find('\n', start)) != string::npos; start = newline + 1) {
+                string line = pending.substr(start, newline - start);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (line == "QUIT") open = false;
+                else replies += handle(line);
+            }
+            pending.erase(0, start);
+            if (!replies.empty() && !sendAll(fd, replies)) break;
+        }
+        lock_guard<mutex> guard(clientsLock);
+        clientSockets.erase(find(clientSockets.begin(), clientSockets.end(), fd));
+        ::close(fd);
+        clientsDone.notify_all();
+    }
+
+    void acceptClients() {
+        while (!stopping) {
+            pollfd waiting = { listener, POLLIN, 0 };
+            if (poll(&waiting, 1, 100) <= 0) continue; // Wake up now and then to notice stop()
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd < 0) continue;
+            lock_guard<mutex> guard(clientsLock);
+            clientSockets.push_back(fd);
+            thread(&ReservationServer::serve, this, fd).detach();
+        }
+    }
+
+public:
+    explicit ReservationServer(RentalManager& rentalManager) : rentalManager(rentalManager) {}
+
+    ~ReservationServer() {
+        stop();
+    }
+
+    // Listen on the socket at socketPath, replacing a stale socket left there by an earlier run
+    bool start(const string& socketPath) {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(address.sun_path)) {
+            cerr << "Socket path is too long: " << socketPath << endl;
+            return false;
+        }
+        memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+        struct stat existing;
+        if (lstat(socketPath.c_str(), &existing) == 0) {
+            if (!S_ISSOCK(existing.st_mode)) {
+                cerr << socketPath << " exists and is not a socket" << endl;
+                return false;
+            }
+            unlink(socketPath.c_str());
+        }
+
+        rentalManager.prepareForServing();
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+            || listen(listener, SOMAXCONN) != 0) {
+            cerr << "Cannot listen on " << socketPath << ": " << strerror(errno) << endl;
+            if (listener >= 0) ::close(listener);
+            listener = -1;
+            return false;
+        }
+        path = socketPath;
+        stopping = false;
+        acceptor = thread(&ReservationServer::acceptClients, this);
+        return true;
+    }
+
+    // Stop accepting, disconnect every client and wait for their threads to finish
+    void stop() {
+        if (listener < 0) return;
+        stopping = true;
+        acceptor.join();
+        ::close(listener);
+        listener = -1;
+        unlink(path.c_str());
+        unique_lock<mutex> guard(clientsLock);
+        for (int fd : clientSockets) {
+            shutdown(fd, SHUT_RDWR);
+        }
+        clientsDone.wait(guard, [this] { return clientSockets.empty(); });
+    }
+};
+
+// A client connection to a ReservationServer; -1 if it cannot connect
+int connectToServer(const string& socketPath) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) return -1;
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+// Serve the data files in the current directory until SIGINT or SIGTERM; returns the exit code
+int runServer(const string& socketPath, Durability durability) {
+    ensureFileExists("users.txt");
+    ensureFileExists("items.txt");
+    ensureFileExists("rental_history.txt");
+
+    // Blocked before any thread starts, so only sigwait below sees them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    RentalManager rentalManager;
+    rentalManager.load();
+    rentalManager.setDurability(durability, Durability::Synced);
+    UserManager& userManager = UserManager::instance();
+    ReservationServer server(rentalManager);
+    if (!server.start(socketPath)) return 1;
+    cout << "Serving reservations on " << socketPath << "; stop with Ctrl+C.\n" << flush;
+
+    int received;
+    sigwait(&signals, &received);
+    cout << "Stopping.\n";
+    server.stop();
+    rentalManager.compactIfChanged();
+    userManager.compactIfChanged();
+    return 0;
+}
+
+// Start a server on a scratch copy of a generated catalogue, then reserve from it through the socket
+// with 1, 2, 4, ... up to maxThreads client threads. Every item name has several copies, and all threads
+// ask for random names, so they keep racing for the same items. Reports successful reservations per
+// second and latency per round, and checks that no item was handed out twice.
+int runLoadTest(unsigned maxThreads, size_t requestsPerThread, Durability durability) {
+    const size_t COPIES_PER_NAME = 4;
+    const string email = "load@test";
+
+    size_t totalRequests = 0;
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) totalRequests += threads * requestsPerThread;
+    size_t itemCount = max<size_t>(2 * totalRequests, COPIES_PER_NAME); // Enough that most requests succeed
+    size_t nameCount = itemCount / COPIES_PER_NAME;
+
+    char directory[] = "/tmp/rental-load-XXXXXX";
+    if (!mkdtemp(directory) || chdir(directory) != 0) {
+        cerr << "Cannot create a scratch directory" << endl;
+        return 1;
+    }
+    ofstream("users.txt") << "Load Test," << email << ",load,Renter\n";
+    Item item("", "", 0, true);
+    writeCatalogue("items.bin", itemCount, [&](size_t index) -> const Item& {
+        item = Item("Tool " + to_string(index % nameCount), "Load test item", 10, true);
+        return item;
+    });
+
+    int result = 0;
+    {
+        RentalManager rentalManager;
+        rentalManager.load();
+        rentalManager.setDurability(durability, Durability::Synced);
+        UserManager::instance();
+        ReservationServer server(rentalManager);
+        if (!server.start("rental.sock")) {
+            rentalManager.compactIfChanged();
+            return 1;
+        }
+
+        cout << "Load test in " << directory << ": " << itemCount << " items, " << nameCount << " names, "
+            << (durability == Durability::Synced ? "synced" : "buffered") << " reservations\n";
+        cout << "threads  requests  reserved  reservations/s   p50 us   p99 us\n";
+        vector<char> reserved(itemCount, 0);
+        size_t conflicts = 0;
+        for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+            vector<vector<double>> latencies(threads);
+            vector<vector<size_t>> claimed(threads);
+            atomic<size_t> failures{ 0 };
+            vector<thread> clients;
+            auto started = chrono::steady_clock::now();
+            for (unsigned client = 0; client < threads; client++) {
+                clients.emplace_back([&, client] {
+                    int fd = connectToServer("rental.sock");
+                    if (fd < 0) {
+                        failures++;
+                        return;
+                    }
+                    mt19937_64 random(client * 7919 + threads);
+                    string reply;
+                    char buffer[256];
+                    for (size_t request = 0; request < requestsPerThread; request++) {
+                        string line = "RESERVE " + email + " Tool " + to_string(random() % nameCount) + "\n";
+                        auto sent = chrono::steady_clock::now();
+                        if (send(fd, line.data(), line.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(line.size())) {
+                            failures++;
+                            break;
+                        }
+                        reply.clear();
+                        while (reply.empty() || reply.back() != '\n') {
+                            ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+                            if (received <= 0) break;
+                            reply.append(buffer, static_cast<size_t>(received));
+                        }
+                        latencies[client].push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - sent).count());
+                        if (reply.compare(0, 3, "OK ") == 0) claimed[client].push_back(stoull(reply.substr(3)));
+                        else if (reply != "UNAVAILABLE\n") failures++;
+                    }
+                    ::close(fd);
+                });
+            }
+            for (thread& client : clients) client.join();
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+            vector<double> all;
+            size_t reservations = 0;
+            for (unsigned client = 0; client < threads; client++) {
+                all.insert(all.end(), latencies[client].begin(), latencies[client].end());
+                for (size_t index : claimed[client]) {
+                    if (index >= itemCount || reserved[index]) conflicts++;
+                    else reserved[index] = 1;
+                    reservations++;
+                }
+            }
+            sort(all.begin(), all.end());
+            auto percentile = [&](double share) { return all.empty() ? 0.0 : all[min(all.size() - 1, size_t(share * all.size()))]; };
+            printf("%7u  %8zu  %8zu  %14.0f  %7.1f  %7.1f\n", threads, all.size(), reservations, reservations / seconds,
+                percentile(0.50), percentile(0.99));
+            if (failures > 0) {
+                cerr << failures << " requests failed" << endl;
+                result = 1;
+            }
+        }
+        cout << "Items reserved twice: " << conflicts << "\n";
+        if (conflicts > 0) result = 1;
+        server.stop();
+    }
+
+    for (const char* file : { "users.txt", "users_journal.txt", "items.bin", "rental_journal.txt", "rental_history.txt",
+        "bookings.txt", "compaction.ready", "users_compaction.ready" }) {
+        remove(file);
+    }
+    if (chdir("/") != 0 || rmdir(directory) != 0) cerr << "Left files in " << directory << endl;
+    return result;
+}
+#endif
+
 // Main Function
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1) {
+        string mode = argv[1];
+        if (mode == "--serve" || mode == "--load-test") {
+#ifdef _WIN32
+            cerr << mode << " needs Unix domain sockets and is not available in this build\n";
+            return 1;
+#else
+            // Reservations are confirmed before they reach the disk unless "synced" is given
+            int durabilityArgument = mode == "--serve" ? 3 : 4;
+            string durabilityName = argc > durabilityArgument ? argv[durabilityArgument] : "buffered";
+            if (durabilityName != "buffered" && durabilityName != "synced") {
+                cerr << "Durability must be buffered or synced, not " << durabilityName << endl;
+                return 1;
+            }
+            Durability durability = durabilityName == "synced" ? Durability::Synced : Durability::Buffered;
+            if (mode == "--serve") return runServer(argc > 2 ? argv[2] : "rental.sock", durability);
+            unsigned maxThreads = argc > 2 ? static_cast<unsigned>(atoi(argv[2])) : max(1u, thread::hardware_concurrency());
+            size_t requestsPerThread = argc > 3 ? static_cast<size_t>(atoll(argv[3])) : 20000;
+            return runLoadTest(max(1u, maxThreads), max<size_t>(1, requestsPerThread), durability);
+#endif
+        }
+        if ((mode == "--import-items" || mode == "--export-items" || mode == "--import-users" || mode == "--export-users")
+            && argc == 3) {
+            return bulkTransfer(mode, argv[2]);
+        }
+        if ((mode != "--to-binary" && mode != "--to-csv") || argc > 4) {
+            cerr << "Usage: " << argv[0] << " [--to-binary [items.txt [items.bin]] | --to-csv [items.bin [items.txt]]\n"
+                << "    | --import-items FILE | --export-items FILE | --import-users FILE | --export-users FILE\n"
+                << "    | --serve [socket [buffered|synced]] | --load-test [max threads [requests per thread [buffered|synced]]]]\n";
+            return 1;
+        }
+        bool toBinary = mode == "--to-binary";
+        string from = argc > 2 ? argv[2] : (toBinary ? "items.txt" : "items.bin");
+        string to = argc > 3 ? argv[3] : (toBinary ? "items.bin" : "items.txt");
+        return convertCatalogue(mode, from, to);
+    }
+
     ensureFileExists("users.txt");
     ensureFileExists("items.txt");
     ensureFileExists("rental_history.txt");
 
     RentalManager rentalManager;
-    rentalManager.loadItems();
-    rentalManager.loadRentalHistory();
+    rentalManager.load();
 
-    UserManager userManager;
-    userManager.loadUsers();
+    UserManager& userManager = UserManager::instance();
 
     int choice;
     while (true) {
@@ -491,6 +3307,8 @@ int main() {
         }
         else if (choice == 3) {
             cout << "Exiting program.\n";
+            rentalManager.compactIfChanged();
+            userManager.compactIfChanged();
             break;
         }
         else {